@@ -263,6 +263,7 @@ namespace alkane {
 		}
 
 	void Formaldehyde::SetAtoms () {
+		if (this->_Current (_atoms_frame)) return;
 
 		this->_c = this->GetAtom(Atom::C);
 		this->_o = this->GetAtom(Atom::O);
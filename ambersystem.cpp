@@ -7,14 +7,15 @@ namespace md_files {
 		: 	
 			MDSystem (),
 			_topfile(prmtop),
-			_coords(mdcrd, _topfile.NumAtoms()),
-			_periodic(periodic)
+			_coords(_OpenTrajectory(mdcrd, _topfile.NumAtoms(), periodic)),
+			_periodic(periodic),
+			_slab_axis(-1)
 			//_forces(mdvel, _topfile.NumAtoms())
 	{
 		_atoms = md_system::Atom_ptr_vec(_topfile.NumAtoms(), (md_system::AtomPtr)NULL);
 
 		// A lot of functionality depends on knowing the system size - so we set it here
-		MDSystem::Dimensions (_coords.Dimensions());
+		MDSystem::Dimensions (_coords->Dimensions());
 
 		// and parse all the info out of the topology file into the atoms
 		this->_ParseAtomInformation ();
@@ -31,6 +32,14 @@ namespace md_files {
 		for (md_system::Atom_ptr_vec::iterator it = _atoms.begin(); it != _atoms.end(); it++) {
 			delete *it;
 		}
+		delete _coords;
+	}
+
+	// netcdf trajectories (mdcrd.nc) are read directly. Anything else is taken to be the flat binary produced by convertmdcrd
+	CoordinateFile * AmberSystem::_OpenTrajectory (const std::string& mdcrd, const int num_atoms, const bool periodic) {
+		if (NCFile::IsNetCDF (mdcrd))
+			return new NCFile (mdcrd, num_atoms, periodic);
+		return new CRDFile (mdcrd, num_atoms, periodic);
 	}
 
 	// While the crdfile holds spatial coordinate information, and the topology file holds atomic information, the data has to be processed into proper atoms in order to play around with them more effectively.
@@ -38,7 +47,7 @@ namespace md_files {
 	void AmberSystem::_ParseAtomInformation () {
 		//double * frc;	// This isn't set yet!
 		for (int i = 0; i < _topfile.NumAtoms(); i++) {
-			_atoms[i] = new md_system::Atom(_topfile.AtomNames()[i], _coords(i));//, frc);
+			_atoms[i] = new md_system::Atom(_topfile.AtomNames()[i], (*_coords)(i));//, frc);
 			_atoms[i]->ID(i);// set the atom's index number - because we may need to access ordered/list info elsewhere
 		}
 
@@ -110,9 +119,48 @@ namespace md_files {
 	}
 
 	void AmberSystem::LoadNext () {
-		_coords.LoadNext ();							// load up coordinate information from the file
+		Molecule::NextFrame();
+		_coords->LoadNext ();							// load up coordinate information from the file
 		//if (_forces.Loaded()) _forces.LoadNext ();		// also load the force information while we're at it
 		//this->_ParseAtomVectors ();
+		if (_slab_axis >= 0 && _coords->FullFrame() && !_coords->eof())
+			this->_SelectSlabAtoms();
+		return;
+	}
+
+	// everything is read at the new frame, since the atoms outside of the slab have nothing to do with it
+	void AmberSystem::Rewind () {
+		Molecule::NextFrame();
+		if (_slab_axis >= 0)
+			_coords->Select (std::vector<int>());
+		_coords->Rewind();
+		if (_slab_axis >= 0)
+			this->_SelectSlabAtoms();
+		return;
+	}
+
+	void AmberSystem::Seek (const int frame) {
+		Molecule::NextFrame();
+		if (_slab_axis >= 0)
+			_coords->Select (std::vector<int>());
+		_coords->Seek(frame);
+		if (_slab_axis >= 0)
+			this->_SelectSlabAtoms();
+		return;
+	}
+
+	void AmberSystem::SelectSlab (const int axis, const double low, const double high, const int refresh) {
+		_slab_axis = axis;
+		_slab_low = low;
+		_slab_high = high;
+		_slab_refresh = refresh;
+		// picked from the frame already loaded
+		this->_SelectSlabAtoms();
+		return;
+	}
+
+	void AmberSystem::_SelectSlabAtoms () {
+		_coords->Select (MDSystem::SlabAtoms (_mols, _slab_axis, _slab_low, _slab_high), _slab_refresh);
 		return;
 	}
 
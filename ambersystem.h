@@ -3,6 +3,7 @@
 
 #include "mdsystem.h"
 #include "crdfile.h"
+#include "ncfile.h"
 //#include "forcefile.h"
 #include "topfile.h"
 //#include "graph.h"
@@ -15,15 +16,23 @@ namespace md_files {
 
 		protected:
 			TOPFile		_topfile;
-			CRDFile		_coords;
+			CoordinateFile *	_coords;		// either a flat binary crd file or a netcdf trajectory
 			bool _periodic;
 
 			void _ParseAtomInformation ();
 			void _ParseMolecules ();
+			// opens the trajectory with the reader that matches its format
+			static CoordinateFile * _OpenTrajectory (const std::string& mdcrd, const int num_atoms, const bool periodic);
 
 			Atom_ptr_vec	_atoms;		// the atoms in the system
 			Mol_ptr_vec		_mols;		// the molecules in the system
 
+			// the slab of the system being loaded (see SelectSlab) - the axis is -1 when everything is loaded
+			int			_slab_axis;
+			double	_slab_low, _slab_high;
+			int			_slab_refresh;
+			void _SelectSlabAtoms ();
+
 		public:
 			// constructors
 			AmberSystem (const std::string& prmtop, const std::string& mdcrd, const bool periodic=true);//, const std::string& mdvel = "");
@@ -32,14 +41,18 @@ namespace md_files {
 			// Controller & Calculation methods
 			void LoadNext ();	 					// Update the system to the next timestep
 			void LoadFirst ();
-			void Rewind () { 
-				_coords.Rewind(); 
-			}
+			void Rewind ();
+			void Seek (const int frame);
+			int NumFrames () const { return _coords->NumFrames(); }
+			// reads up to depth frames of the trajectory ahead in the background
+			void Prefetch (const int depth) { _coords->Prefetch(depth); }
+			/* Only loads the atoms of the molecules that have an atom within [low, high] along the axis - the other atoms keep the positions they had when they were last in the slab. Every refresh frames (if refresh > 0) the whole frame is read and the molecules in the slab are picked anew. */
+			void SelectSlab (const int axis, const double low, const double high, const int refresh = 0);
 
-			bool eof () const { return _coords.eof(); }
+			bool eof () const { return _coords->eof(); }
 
 			// Output
-			const VecR&	Dimensions () 		const { return _coords.Dimensions(); }		// returns the system size.
+			const VecR&	Dimensions () 		const { return _coords->Dimensions(); }		// returns the system size.
 
 			//! The set of all molecules in a system
 			Mol_ptr_vec& Molecules () { return _mols; }
@@ -38,6 +38,13 @@ namespace md_analysis {
 		Analyzer::timesteps = WaterSystem::SystemParameterLookup("system.timesteps");
 		Analyzer::restart = WaterSystem::SystemParameterLookup("analysis.restart-time");
 
+		// don't run the analysis past the end of the trajectory
+		int frames = sys->NumFrames();
+		if (frames >= 0 && Analyzer::restart + Analyzer::timesteps > frames) {
+			Analyzer::timesteps = std::max (frames - Analyzer::restart, 0);
+			printf ("The trajectory only has %d frames - analyzing %d timesteps\n", frames, Analyzer::timesteps);
+		}
+
 		status_updater.Set (output_freq, timesteps, 0);
 		this->registerObserver(&status_updater);
 
@@ -53,8 +53,13 @@ namespace md_analysis {
 				this->sys->Rewind();
 				timestep = 1;
 			}
+			// jumps straight to a frame of the trajectory
+			void Seek (const int frame) { this->sys->Seek(frame); }
+			// the trajectory has run out of frames
+			bool eof () const { return this->sys->eof(); }
 
 			void LoadWaters () { sys->LoadWaters(); }
+			const AtomStore& Store () const { return sys->Store(); }
 
 			void OutputStatus ();
 			bool ReadyToOutputData () const { 
@@ -131,10 +136,10 @@ namespace md_analysis {
 		public:
 			atomic_distance_cmp (const AtomPtr refatom) : _v (refatom->Position()) { }
 			atomic_distance_cmp (const VecR v) : _v (v) { }
-			// return the distance between the two molecules and the reference mol
+			// compare the distances between the two atoms and the reference point (squared, which orders them the same)
 			bool operator()(const AtomPtr left, const AtomPtr right) const {
-				double left_dist = MDSystem::Distance(left->Position(), _v).norm();
-				double right_dist = MDSystem::Distance(right->Position(), _v).norm();
+				double left_dist = MDSystem::Distance(left->Position(), _v).squaredNorm();
+				double right_dist = MDSystem::Distance(right->Position(), _v).squaredNorm();
 				return left_dist < right_dist;
 			}
 	};
@@ -170,8 +175,9 @@ namespace md_analysis {
 					 left->ReferencePoint().Print();
 					 _v.Print();
 					 */
-				double left_dist = MDSystem::Distance(left->ReferencePoint(), _v).norm();
-				double right_dist = MDSystem::Distance(right->ReferencePoint(), _v).norm();
+				// squared distances order the molecules the same, without the square roots
+				double left_dist = MDSystem::Distance(left->ReferencePoint(), _v).squaredNorm();
+				double right_dist = MDSystem::Distance(right->ReferencePoint(), _v).squaredNorm();
 				return left_dist < right_dist;
 			}
 	};
@@ -242,6 +248,7 @@ namespace md_analysis {
 
 			void LoadAll () const { this->_system->LoadAll(); }
 			void LoadWaters () const { this->_system->LoadWaters(); }
+			const AtomStore& Store () const { return this->_system->Store(); }
 
 			Atom_it_non_const begin () const { return WaterSystem::int_atoms.begin(); }
 			Atom_it_non_const end () const { return WaterSystem::int_atoms.end(); }
@@ -0,0 +1,429 @@
+#include "arcadefile.h"
+
+namespace md_files {
+
+	namespace arcade {
+
+		// the frame count and the three stream sizes that start each chunk
+		static const long long CHUNK_HEADER_BYTES = sizeof(unsigned int) + NUM_STREAMS * sizeof(unsigned long long);
+		// the footer offset and magic number at the very end of the file
+		static const long long TRAILER_BYTES = sizeof(long long) + sizeof(FOOTER_MAGIC);
+
+		bool IsArcadeFile (const std::string& path) {
+			char magic[4];
+			return GzipFile::Peek (path, magic, 4) == 4 && !memcmp (magic, MAGIC, 4);
+		}
+
+		// small signed values (of either sign) become small unsigned ones
+		static inline unsigned long long zigzag (const long long value) {
+			return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+		}
+		static inline long long unzigzag (const unsigned long long value) {
+			return (long long)(value >> 1) ^ -(long long)(value & 1);
+		}
+
+		// 7 bits to a byte, with the high bit set on all but the last byte
+		static inline void put_varint (std::vector<unsigned char>& stream, unsigned long long value) {
+			while (value >= 0x80) {
+				stream.push_back ((unsigned char)(value | 0x80));
+				value >>= 7;
+			}
+			stream.push_back ((unsigned char)value);
+		}
+		// false if the stream runs out in the middle of a value, or the value runs past 64 bits
+		static inline bool get_varint (const unsigned char *& p, const unsigned char * end, unsigned long long& value) {
+			value = 0;
+			int shift = 0;
+			while (p < end && (*p & 0x80)) {
+				if (shift > 63) return false;
+				value |= (unsigned long long)(*p++ & 0x7f) << shift;
+				shift += 7;
+			}
+			if (p == end || shift > 63) return false;
+			value |= (unsigned long long)(*p++) << shift;
+			return true;
+		}
+
+		static void write_string (FILE * file, const std::string& s) {
+			unsigned int len = (unsigned int)s.size();
+			fwrite (&len, sizeof(unsigned int), 1, file);
+			fwrite (s.c_str(), sizeof(char), len, file);
+		}
+
+	}	// namespace arcade
+
+	using namespace arcade;
+
+
+
+	ArcadeWriter::ArcadeWriter (const std::string& path, const std::vector<std::string>& names, const int num_wanniers, const topology_vec& topology, const double precision, const int chunk_frames) :
+		_file ((FILE *)NULL),
+		_path(path),
+		_num_atoms((int)names.size()), _num_wanniers(num_wanniers),
+		_precision(precision), _chunk_frames(chunk_frames),
+		_num_frames(0), _frames(0),
+		_last_coords(3*names.size(), 0), _last_wanniers(3*num_wanniers, 0) {
+
+			_file = fopen64 (path.c_str(), "wb");
+			if (_file == (FILE *)NULL) {
+				printf ("ArcadeWriter c-tor - Couldn't open %s for writing\n", path.c_str());
+				exit(1);
+			}
+			if (_chunk_frames < 1) _chunk_frames = 1;
+
+			unsigned int header[4] = { VERSION, (unsigned int)_num_atoms, (unsigned int)_num_wanniers, (unsigned int)_chunk_frames };
+			fwrite (MAGIC, 1, 4, _file);
+			fwrite (header, sizeof(unsigned int), 4, _file);
+			fwrite (&_precision, sizeof(double), 1, _file);
+
+			for (std::vector<std::string>::const_iterator it = names.begin(); it != names.end(); it++)
+				write_string (_file, *it);
+
+			unsigned int num_mols = (unsigned int)topology.size();
+			fwrite (&num_mols, sizeof(unsigned int), 1, _file);
+			for (topology_vec::const_iterator it = topology.begin(); it != topology.end(); it++) {
+				write_string (_file, std::string(it->name));
+				unsigned int size = (unsigned int)it->atoms.size();
+				fwrite (&size, sizeof(unsigned int), 1, _file);
+				for (unsigned int i = 0; i < size; i++) {
+					int id = it->atoms[i];
+					fwrite (&id, sizeof(int), 1, _file);
+				}
+			}
+		}
+
+	void ArcadeWriter::WriteFrame (const double * coords, const double * wanniers, const VecR& box) {
+		// each chunk starts from scratch so that it can be decoded on its own
+		if (_frames == 0) {
+			std::fill (_last_coords.begin(), _last_coords.end(), 0);
+			std::fill (_last_wanniers.begin(), _last_wanniers.end(), 0);
+		}
+
+		const double dims[3] = { box[0], box[1], box[2] };
+		std::vector<unsigned char>& box_stream = _streams[BOX];
+		box_stream.insert (box_stream.end(), (const unsigned char *)dims, (const unsigned char *)(dims + 3));
+
+		this->_Encode (coords, 3*_num_atoms, _last_coords, _streams[COORDINATES]);
+		if (_num_wanniers) {
+			if (wanniers == (const double *)NULL) {
+				printf ("ArcadeWriter::WriteFrame() - frame %d of %s is missing its wannier centers\n", _num_frames, _path.c_str());
+				exit(1);
+			}
+			this->_Encode (wanniers, 3*_num_wanniers, _last_wanniers, _streams[WANNIERS]);
+		}
+
+		++_frames;
+		++_num_frames;
+		if (_frames == _chunk_frames)
+			this->_WriteChunk();
+		return;
+	}
+
+	void ArcadeWriter::_Encode (const double * values, const int num, std::vector<long long>& last, std::vector<unsigned char>& stream) {
+		const double scale = 1.0 / _precision;
+		for (int i = 0; i < num; i++) {
+			long long q = (long long)floor(values[i] * scale + 0.5);
+			put_varint (stream, zigzag (q - last[i]));
+			last[i] = q;
+		}
+		return;
+	}
+
+	void ArcadeWriter::_WriteChunk () {
+		if (!_frames) return;
+
+		chunk_t chunk;
+		chunk.offset = ftello64 (_file);
+		chunk.first = _num_frames - _frames;
+		chunk.frames = _frames;
+		_chunks.push_back (chunk);
+
+		unsigned int frames = (unsigned int)_frames;
+		fwrite (&frames, sizeof(unsigned int), 1, _file);
+		for (int s = 0; s < NUM_STREAMS; s++) {
+			unsigned long long bytes = _streams[s].size();
+			fwrite (&bytes, sizeof(unsigned long long), 1, _file);
+		}
+		for (int s = 0; s < NUM_STREAMS; s++) {
+			if (!_streams[s].empty())
+				fwrite (&_streams[s][0], 1, _streams[s].size(), _file);
+			_streams[s].clear();
+		}
+
+		_frames = 0;
+		return;
+	}
+
+	void ArcadeWriter::Close () {
+		if (_file == (FILE *)NULL) return;
+
+		this->_WriteChunk();
+
+		long long footer = ftello64 (_file);
+		unsigned int num_chunks = (unsigned int)_chunks.size();
+		fwrite (&num_chunks, sizeof(unsigned int), 1, _file);
+		for (std::vector<chunk_t>::const_iterator it = _chunks.begin(); it != _chunks.end(); it++) {
+			fwrite (&it->offset, sizeof(long long), 1, _file);
+			fwrite (&it->first, sizeof(int), 1, _file);
+			fwrite (&it->frames, sizeof(int), 1, _file);
+		}
+		fwrite (&footer, sizeof(long long), 1, _file);
+		fwrite (FOOTER_MAGIC, 1, 4, _file);
+
+		fclose (_file);
+		_file = (FILE *)NULL;
+		return;
+	}
+
+
+
+	ArcadeReader::ArcadeReader (const std::string& path, const stream_t stream) :
+		_file ((FILE *)NULL),
+		_path(path),
+		_stream(stream),
+		_num_frames(0),
+		_prefetch(false), _decoding(false) {
+
+			_file = fopen64 (path.c_str(), "rb");
+			if (_file == (FILE *)NULL) {
+				printf ("ArcadeReader c-tor - Couldn't open the arcade file %s\n", path.c_str());
+				exit(1);
+			}
+			_current.chunk = _next.chunk = -1;
+
+			this->_ReadHeader();
+		}
+
+	ArcadeReader::~ArcadeReader () {
+		this->_FinishDecoding();
+		if (_file != (FILE *)NULL)
+			fclose (_file);
+	}
+
+	// reads from a given offset without moving the file position, so the decoder thread can read at the same time
+	void ArcadeReader::_Read (void * buffer, const size_t bytes, const long long offset) const {
+		if (bytes && pread64 (fileno(_file), buffer, bytes, offset) != (ssize_t)bytes) {
+			printf ("ArcadeReader - %s is cut short (reading %lu bytes at %lld)\n", _path.c_str(), (unsigned long)bytes, offset);
+			exit(1);
+		}
+		return;
+	}
+
+	void ArcadeReader::_ReadHeader () {
+		char magic[4];
+		unsigned int header[4];
+		if (fread (magic, 1, 4, _file) != 4 || memcmp (magic, MAGIC, 4) || fread (header, sizeof(unsigned int), 4, _file) != 4 || fread (&_precision, sizeof(double), 1, _file) != 1) {
+			printf ("ArcadeReader::_ReadHeader() - %s isn't an arcade file\n", _path.c_str());
+			exit(1);
+		}
+		if (header[0] != VERSION) {
+			printf ("ArcadeReader::_ReadHeader() - %s was written with version %u of the format, but only version %u can be read\n", _path.c_str(), header[0], VERSION);
+			exit(1);
+		}
+		_num_atoms = (int)header[1];
+		_num_wanniers = (int)header[2];
+
+		char name[256];
+		unsigned int len;
+		for (int i = 0; i < _num_atoms; i++) {
+			if (fread (&len, sizeof(unsigned int), 1, _file) != 1 || len > 255 || fread (name, 1, len, _file) != len) {
+				printf ("ArcadeReader::_ReadHeader() - couldn't read the atom names of %s\n", _path.c_str());
+				exit(1);
+			}
+			_names.push_back (std::string (name, len));
+		}
+
+		unsigned int num_mols = 0;
+		fread (&num_mols, sizeof(unsigned int), 1, _file);
+		for (unsigned int m = 0; m < num_mols; m++) {
+			MolecularTopologyFile::mol_topology_t mol;
+			unsigned int size = 0;
+			if (fread (&len, sizeof(unsigned int), 1, _file) != 1 || len >= sizeof(mol.name) || fread (mol.name, 1, len, _file) != len || fread (&size, sizeof(unsigned int), 1, _file) != 1) {
+				printf ("ArcadeReader::_ReadHeader() - couldn't read the topology of %s\n", _path.c_str());
+				exit(1);
+			}
+			mol.name[len] = '\0';
+			mol.size = (int)size;
+			mol.atoms.resize(size);
+			if (size && fread (&mol.atoms[0], sizeof(int), size, _file) != size) {
+				printf ("ArcadeReader::_ReadHeader() - couldn't read the topology of %s\n", _path.c_str());
+				exit(1);
+			}
+			_topology.push_back (mol);
+		}
+
+		this->_ReadIndex (ftello64 (_file));
+		return;
+	}
+
+	/* The chunk index comes from the footer. A file without one (the writer never finished) is indexed by stepping through the chunks, and any chunk cut off at the end is dropped */
+	void ArcadeReader::_ReadIndex (const long long data_start) {
+		_chunks.clear();
+		_num_frames = 0;
+
+		fseeko64 (_file, 0, SEEK_END);
+		long long file_size = ftello64 (_file);
+
+		char magic[4];
+		long long footer = -1;
+		if (file_size >= data_start + TRAILER_BYTES) {
+			this->_Read (&footer, sizeof(long long), file_size - TRAILER_BYTES);
+			this->_Read (magic, 4, file_size - 4);
+			if (memcmp (magic, FOOTER_MAGIC, 4) || footer < data_start || footer >= file_size)
+				footer = -1;
+		}
+
+		if (footer >= 0) {
+			unsigned int num_chunks;
+			this->_Read (&num_chunks, sizeof(unsigned int), footer);
+			long long offset = footer + sizeof(unsigned int);
+			for (unsigned int c = 0; c < num_chunks; c++) {
+				chunk_t chunk;
+				this->_Read (&chunk.offset, sizeof(long long), offset);
+				this->_Read (&chunk.first, sizeof(int), offset + sizeof(long long));
+				this->_Read (&chunk.frames, sizeof(int), offset + sizeof(long long) + sizeof(int));
+				offset += sizeof(long long) + 2*sizeof(int);
+				_chunks.push_back (chunk);
+			}
+		}
+		else {
+			printf ("ArcadeReader - %s has no frame index. Indexing the chunks one by one\n", _path.c_str());
+			long long offset = data_start;
+			while (offset + CHUNK_HEADER_BYTES <= file_size) {
+				unsigned int frames;
+				unsigned long long bytes[NUM_STREAMS];
+				this->_Read (&frames, sizeof(unsigned int), offset);
+				this->_Read (bytes, sizeof(bytes), offset + sizeof(unsigned int));
+				long long end = offset + CHUNK_HEADER_BYTES + (long long)(bytes[BOX] + bytes[COORDINATES] + bytes[WANNIERS]);
+				if (end > file_size) break;
+
+				chunk_t chunk;
+				chunk.offset = offset;
+				chunk.first = _num_frames;
+				chunk.frames = (int)frames;
+				_chunks.push_back (chunk);
+				_num_frames += chunk.frames;
+				offset = end;
+			}
+		}
+
+		_num_frames = _chunks.empty() ? 0 : _chunks.back().first + _chunks.back().frames;
+		return;
+	}
+
+	int ArcadeReader::_ChunkOf (const int frame) const {
+		// the chunks are all the same size but the last, so the guess is almost always right
+		int c = (_chunks.empty() || !_chunks[0].frames) ? 0 : std::min(frame / _chunks[0].frames, (int)_chunks.size()-1);
+		while (c > 0 && _chunks[c].first > frame) --c;
+		while (c < (int)_chunks.size()-1 && _chunks[c].first + _chunks[c].frames <= frame) ++c;
+		return c;
+	}
+
+	void ArcadeReader::_DecodeChunk (decoded_t& decoded) const {
+		const chunk_t& chunk = _chunks[decoded.chunk];
+
+		unsigned long long bytes[NUM_STREAMS];
+		this->_Read (bytes, sizeof(bytes), chunk.offset + sizeof(unsigned int));
+
+		if (bytes[BOX] != 3*chunk.frames*sizeof(double)) {
+			printf ("ArcadeReader::_DecodeChunk() - chunk %d of %s holds %llu bytes of box for its %d frames\n", decoded.chunk, _path.c_str(), bytes[BOX], chunk.frames);
+			exit(1);
+		}
+		decoded.box.resize (3*chunk.frames);
+		this->_Read (&decoded.box[0], bytes[BOX], chunk.offset + CHUNK_HEADER_BYTES);
+
+		long long offset = chunk.offset + CHUNK_HEADER_BYTES + bytes[BOX];
+		if (_stream == WANNIERS)
+			offset += bytes[COORDINATES];
+		decoded.raw.resize (bytes[_stream] + 1);
+		this->_Read (&decoded.raw[0], bytes[_stream], offset);
+
+		const int num = 3 * this->size();
+		decoded.coords.resize ((size_t)num * chunk.frames);
+		const unsigned char * p = &decoded.raw[0];
+		const unsigned char * end = p + bytes[_stream];
+
+		// the first frame is coded against zero, and each one after against the frame before it
+		std::vector<long long> last (num, 0);
+		double * out = &decoded.coords[0];
+		unsigned long long value;
+		for (int f = 0; f < chunk.frames; f++) {
+			for (int i = 0; i < num; i++) {
+				if (!get_varint (p, end, value)) {
+					printf ("ArcadeReader::_DecodeChunk() - chunk %d of %s is cut short (frame %d of %d)\n", decoded.chunk, _path.c_str(), chunk.first + f, _num_frames);
+					exit(1);
+				}
+				last[i] += unzigzag (value);
+				*out++ = last[i] * _precision;
+			}
+		}
+		// every byte of the stream belongs to the chunk's frames
+		if (p != end) {
+			printf ("ArcadeReader::_DecodeChunk() - chunk %d of %s has %ld bytes left over after its %d frames\n", decoded.chunk, _path.c_str(), (long)(end - p), chunk.frames);
+			exit(1);
+		}
+		return;
+	}
+
+	// pthread-compatible function for running a reader's chunk decoder
+	void * decode_chunk (void * reader) {
+		ArcadeReader * r = static_cast<ArcadeReader *>(reader);
+		r->_DecodeChunk (r->_next);
+		pthread_exit(NULL);
+	}
+
+	void ArcadeReader::_StartDecoding (const int chunk) {
+		this->_FinishDecoding();
+		if (chunk < 0 || chunk >= (int)_chunks.size()) return;
+		_next.chunk = chunk;
+		_decoding = !pthread_create (&_decoder, NULL, decode_chunk, (void *)this);
+		if (!_decoding)
+			_next.chunk = -1;
+		return;
+	}
+
+	void ArcadeReader::_FinishDecoding () {
+		if (_decoding) {
+			pthread_join (_decoder, NULL);
+			_decoding = false;
+		}
+		return;
+	}
+
+	void ArcadeReader::LoadFrame (const int frame, double * coords, VecR& box) {
+		if (frame < 0 || frame >= _num_frames) {
+			printf ("ArcadeReader::LoadFrame() - frame %d is out of range. The file %s has %d frames\n", frame, _path.c_str(), _num_frames);
+			exit(1);
+		}
+
+		const int c = this->_ChunkOf (frame);
+		if (_current.chunk != c) {
+			this->_FinishDecoding();
+			if (_next.chunk == c) {
+				std::swap (_current.chunk, _next.chunk);
+				_current.coords.swap (_next.coords);
+				_current.box.swap (_next.box);
+				_current.raw.swap (_next.raw);
+			}
+			else {
+				_current.chunk = c;
+				this->_DecodeChunk (_current);
+			}
+			_next.chunk = -1;
+
+			// the chunk after this one is decoded while this one is worked through
+			if (_prefetch)
+				this->_StartDecoding (c+1);
+		}
+
+		const int num = 3 * this->size();
+		const int f = frame - _chunks[c].first;
+		if (num)
+			memcpy (coords, &_current.coords[(size_t)f * num], num * sizeof(double));
+		box[0] = _current.box[3*f];
+		box[1] = _current.box[3*f+1];
+		box[2] = _current.box[3*f+2];
+		return;
+	}
+
+}	// namespace md_files
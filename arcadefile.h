@@ -0,0 +1,149 @@
+#ifndef ARCADEFILE_H_
+#define ARCADEFILE_H_
+
+#include "vecr.h"
+#include "moltopologyfile.h"
+#include "gzipfile.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+#include <unistd.h>
+
+// The native Arcade trajectory container (.arc)
+
+namespace md_files {
+
+	/* A single file holding everything an xyz system needs: the atom names and molecular topology in the header, then the frames in chunks. Each chunk holds three streams - the box of each frame, the atom coordinates, and the wannier centers - so a reader only has to touch the stream it wants.
+
+		 Coordinates (and wannier centers) are quantized to a fixed precision and stored as the change from the same value in the frame before, zig-zag and varint coded. Atoms move little from one frame to the next, so most values take up 1-2 bytes rather than 8. The first frame of a chunk is coded against zero, so chunks can be decoded on their own (and in parallel). A footer at the end of the file lists where each chunk starts and which frames it holds.
+
+		 Layout (native byte order, as with the other binary files):
+		 header:	"ARCD" version num_atoms num_wanniers chunk_frames precision
+		 					atom names (length + characters)
+		 					topology (number of molecules, then the name, size and atom ids of each)
+		 chunk:		num_frames, the byte size of each stream, then the box, coordinate and wannier streams
+		 footer:	number of chunks, then the offset, first frame, and number of frames of each
+		 					offset of the footer, "ARCX"
+		 */
+	namespace arcade {
+
+		enum stream_t { BOX = 0, COORDINATES, WANNIERS, NUM_STREAMS };
+
+		static const char MAGIC[4] = { 'A', 'R', 'C', 'D' };
+		static const char FOOTER_MAGIC[4] = { 'A', 'R', 'C', 'X' };
+		static const unsigned int VERSION = 1;
+
+		// default quantization of the positions (angstroms), and the default number of frames in a chunk
+		const double PRECISION = 1.0e-5;
+		const int CHUNK_FRAMES = 32;
+
+		typedef MolecularTopologyFile::mol_topology_vec	topology_vec;
+
+		// checks the magic number at the start of a file (looking through gzip compression - see GzipFile::Peek)
+		bool IsArcadeFile (const std::string& path);
+
+		struct chunk_t {
+			long long	offset;
+			int				first;		// the first frame held in the chunk
+			int				frames;
+		};
+
+	}	// namespace arcade
+
+
+	class ArcadeWriter {
+
+		public:
+			ArcadeWriter (const std::string& path, const std::vector<std::string>& names, const int num_wanniers, const arcade::topology_vec& topology = arcade::topology_vec(), const double precision = arcade::PRECISION, const int chunk_frames = arcade::CHUNK_FRAMES);
+			~ArcadeWriter () { this->Close(); }
+
+			// adds a frame of num_atoms coordinates and num_wanniers wannier centers (which may be NULL when there are none)
+			void WriteFrame (const double * coords, const double * wanniers, const VecR& box);
+			// writes out the last chunk and the footer
+			void Close ();
+
+			int NumFrames () const { return _num_frames; }
+
+		protected:
+			FILE *				_file;
+			std::string		_path;
+			int						_num_atoms, _num_wanniers;
+			double				_precision;
+			int						_chunk_frames;
+
+			int						_num_frames;
+			std::vector<arcade::chunk_t>	_chunks;
+
+			// the chunk being put together
+			int												_frames;
+			std::vector<unsigned char>	_streams[arcade::NUM_STREAMS];
+			std::vector<long long>			_last_coords;			// quantized values of the previous frame
+			std::vector<long long>			_last_wanniers;
+
+			void _Encode (const double * values, const int num, std::vector<long long>& last, std::vector<unsigned char>& stream);
+			void _WriteChunk ();
+	};
+
+
+	/* Reads one of the streams (coordinates or wannier centers) out of a container. A whole chunk is decoded at a time, and with Prefetch set the next chunk is decoded by a second thread while the current one is being worked through. */
+	class ArcadeReader {
+
+		public:
+			ArcadeReader (const std::string& path, const arcade::stream_t stream);
+			~ArcadeReader ();
+
+			int NumFrames () const { return _num_frames; }
+			// the number of positions in each frame of the stream
+			int size () const { return (_stream == arcade::WANNIERS) ? _num_wanniers : _num_atoms; }
+
+			const std::vector<std::string>& AtomNames () const { return _names; }
+			const arcade::topology_vec& Topology () const { return _topology; }
+
+			// copies the given frame into coords, and its box into box
+			void LoadFrame (const int frame, double * coords, VecR& box);
+			// decodes the next chunk in the background
+			void Prefetch (const bool prefetch) { _prefetch = prefetch; }
+
+		protected:
+			FILE *				_file;
+			std::string		_path;
+			arcade::stream_t	_stream;
+
+			int						_num_atoms, _num_wanniers;
+			double				_precision;
+			int						_num_frames;
+			std::vector<std::string>	_names;
+			arcade::topology_vec			_topology;
+			std::vector<arcade::chunk_t>	_chunks;
+
+			// a decoded chunk - the positions and box of each of its frames
+			struct decoded_t {
+				int											chunk;
+				std::vector<double>			coords;
+				std::vector<double>			box;
+				std::vector<unsigned char>	raw;
+			};
+			decoded_t			_current;
+			decoded_t			_next;
+
+			bool					_prefetch;
+			bool					_decoding;			// set while the decoder thread is working on _next
+			pthread_t			_decoder;
+
+			void _ReadHeader ();
+			void _ReadIndex (const long long data_start);
+			void _Read (void * buffer, const size_t bytes, const long long offset) const;
+			void _DecodeChunk (decoded_t& decoded) const;
+			void _StartDecoding (const int chunk);
+			void _FinishDecoding ();
+			int _ChunkOf (const int frame) const;
+			friend void * decode_chunk (void * reader);
+	};
+
+}	// namespace md_files
+#endif
@@ -1,9 +1,13 @@
 #include "atom.h"
+#include "molecule.h"
+#include <map>
+#include <deque>
+#include <pthread.h>
 
 namespace md_system {
 
 	Atom::Atom (const std::string& name, double * position) ://, const double * force) :
-		_name(name), _residue(""), 
+		_name(name), _residue(""), _name_id(Atom::NameID(name)),
 		_ID(-1), _molid(-1),
 		_pmolecule((Molecule *)NULL),
 		//_position(vector_map (position)), _force(vector_map (force))
@@ -12,7 +16,7 @@ namespace md_system {
 
 	// copy constructor will pull over all the member values, and copy over the vector values
 	Atom::Atom (const Atom& oldAtom) :
-		_name(oldAtom._name), _residue(oldAtom._residue), _ID(oldAtom._ID), _molid(oldAtom._molid),
+		_name(oldAtom._name), _residue(oldAtom._residue), _name_id(oldAtom._name_id), _ID(oldAtom._ID), _molid(oldAtom._molid),
 		_pmolecule(oldAtom._pmolecule),
 		_mass(oldAtom._mass), _charge(oldAtom._charge),
 		_element(oldAtom._element),
@@ -22,6 +26,51 @@ namespace md_system {
 
 	Atom::~Atom () { }
 
+	void Atom::Charge (double charge) {
+		_charge = charge;
+		if (_pmolecule != (Molecule *)NULL)
+			_pmolecule->InvalidateDipoles();
+	}
+
+	namespace {
+		// The table is built on first use, so names can be interned while other files' statics are being set up. Interning happens as the atoms are loaded, but the lock keeps a lookup from a worker thread safe too
+		struct name_table_t {
+			std::map<std::string, int>	ids;
+			std::deque<std::string>		names;		// a deque, so the names don't move as more are added
+			pthread_mutex_t							lock;
+			name_table_t () { pthread_mutex_init (&lock, NULL); }
+		};
+
+		name_table_t& name_table () {
+			static name_table_t table;
+			return table;
+		}
+	}
+
+	int Atom::NameID (const std::string& name) {
+		name_table_t& table = name_table();
+		pthread_mutex_lock (&table.lock);
+		std::map<std::string, int>::const_iterator it = table.ids.find(name);
+		int id;
+		if (it != table.ids.end())
+			id = it->second;
+		else {
+			id = (int)table.names.size();
+			table.ids.insert (std::make_pair(name, id));
+			table.names.push_back (name);
+		}
+		pthread_mutex_unlock (&table.lock);
+		return id;
+	}
+
+	const std::string& Atom::NameOf (const int id) {
+		name_table_t& table = name_table();
+		pthread_mutex_lock (&table.lock);
+		const std::string& name = table.names[id];
+		pthread_mutex_unlock (&table.lock);
+		return name;
+	}
+
 	void Atom::Position (const vector_base& position) { 
 		_position = position;
 	}
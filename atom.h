@@ -5,6 +5,7 @@
 #include "utility.h"
 #include <vector>
 #include <string>
+#include <new>
 
 namespace md_system {
 
@@ -44,19 +45,21 @@ namespace md_system {
 
 			// Input
 
-			void Name (const std::string& name) { _name = name; }
+			void Name (const std::string& name) { _name = name; _name_id = Atom::NameID(name); }
 
 			void Position (const vector_base& position);
 			void Position (const double X, const double Y, const double Z);
 
 			void Position (coord const axis, double const value);
+			// re-points the atom's position at another set of coordinates rather than copying them in
+			void MapPosition (double * position) { new (&_position) vector_map (position); }
 
 			//void Force (const vector_base& force) { _force = force; }
 			//void Force (const double X, const double Y, const double Z) { _force.Set(X, Y, Z); }
 			//void Force (coord const axis, double const value) { _force.Set (axis, value); }
 
 			void ID (const int id) { _ID = id; }
-			void Charge (double charge) { _charge = charge; }
+			void Charge (double charge);		// the parent molecule's cached dipoles are thrown away along with the old charge
 			void SetAtomProperties ();
 			void Residue (const std::string& residue) { _residue = residue; }
 
@@ -72,7 +75,8 @@ namespace md_system {
 			{ _position += shift; }
 
 			// Output
-			std::string Name () const 	{ return _name; }
+			const std::string& Name () const 	{ return _name; }
+			int NameID () const { return _name_id; }
 			Element_t Element () const { return _element; }
 			double Mass () const 	{ return _mass; }
 			double Charge () const 	{ return _charge; }
@@ -108,9 +112,14 @@ namespace md_system {
 			static std::string Element2String (Element_t);
 			static Element_t String2Element (const std::string&);
 
+			/* Atom names are interned - each distinct name is given a small integer ID the first time it's seen (in practice, as the atoms are loaded), so atoms can be matched by name with an integer compare rather than a string compare. */
+			static int NameID (const std::string& name);
+			static const std::string& NameOf (const int id);
+
 		protected:
 			std::string			_name,				// human-readable identifier
 				_residue;			// name of the parent-molecule 
+			int			_name_id;				// the interned name
 
 			int    _ID;							// some numerical identifier in case the atom is in an ordered list
 			int	   _molid;					// the molecule that contains this atom
@@ -127,6 +136,19 @@ namespace md_system {
 	};	// class Atom
 
 
+	/* An atom name that's been interned ahead of time. Loops that look atoms up by name hold one of these (usually as a static) rather than a string, e.g.
+			static const AtomName oxygen ("O");
+			AtomPtr o = mol->GetAtom(oxygen);
+	 */
+	class AtomName {
+		public:
+			explicit AtomName (const std::string& name) : _id(Atom::NameID(name)) { }
+			int ID () const { return _id; }
+			const std::string& Name () const { return Atom::NameOf(_id); }
+		private:
+			int _id;
+	};
+
 	typedef Atom::AtomPtr AtomPtr;
 	typedef Atom::Atom_ptr_vec Atom_ptr_vec;
 	typedef std::list<AtomPtr> Atom_ptr_list;
@@ -0,0 +1,52 @@
+#include "atomstore.h"
+
+namespace md_system {
+
+	AtomStore::AtomStore () : _size(0) { }
+
+	void AtomStore::Assign (const Atom_ptr_vec& atoms) {
+		_atoms = atoms;
+		_size = (int)atoms.size();
+		const int padded = (_size + WIDTH - 1) / WIDTH * WIDTH;
+
+		// the padding is cleared here, and never written to again
+		_x.assign (padded, 0.0);
+		_y.assign (padded, 0.0);
+		_z.assign (padded, 0.0);
+		_masses.assign (padded, 0.0);
+		_charges.assign (padded, 0.0);
+		_elements.assign (padded, Atom::NO_ELEMENT);
+		_molids.assign (padded, -1);
+
+		int max_id = -1;
+		for (int i = 0; i < _size; i++) {
+			_masses[i] = _atoms[i]->Mass();
+			_elements[i] = _atoms[i]->Element();
+			if (_atoms[i]->ID() > max_id) max_id = _atoms[i]->ID();
+		}
+
+		_index.assign (max_id+1, -1);
+		for (int i = 0; i < _size; i++) {
+			if (_atoms[i]->ID() >= 0)
+				_index[_atoms[i]->ID()] = i;
+		}
+
+		this->Update ();
+		return;
+	}
+
+	// The atoms are visited once, and each array is written straight through
+	void AtomStore::Update () {
+		for (int i = 0; i < _size; i++) {
+			const AtomPtr atom = _atoms[i];
+			const vector_map& position = atom->Position();
+			_x[i] = (coord_real)position[x];
+			_y[i] = (coord_real)position[y];
+			_z[i] = (coord_real)position[z];
+			_charges[i] = atom->Charge();
+			_molids[i] = atom->MolID();
+		}
+		return;
+	}
+
+}	// namespace md system
@@ -0,0 +1,68 @@
+#ifndef ATOMSTORE_H_
+#define ATOMSTORE_H_
+
+#include "atom.h"
+#include <vector>
+
+namespace md_system {
+
+	/* A structure-of-arrays copy of a set of atoms, for the routines that stream over all the atoms of a system.
+
+		 The x, y and z coordinates each sit in their own contiguous array, with the element, mass, charge and molecule ID of every atom in arrays running alongside them - entry i of each array belongs to Atoms(i). The coordinate and property arrays are 16-byte aligned, and padded with zeros out to a multiple of WIDTH entries, so a vectorized loop can run over Padded() entries without a remainder loop (the zero masses and charges of the padding keep it out of any weighted sums).
+
+		 The atoms themselves stay where they are - the store is filled from them. Assign lays it out for a set of atoms, and Update copies in the values that change from frame to frame (positions, charges and molecule IDs).
+	 */
+	class AtomStore {
+
+		public:
+
+			AtomStore ();
+
+			// coordinate values per SIMD register the arrays are padded for (4 doubles in an AVX register)
+			static const int WIDTH = 4;
+
+			// lays the store out for the given atoms, and copies in all their values
+			void Assign (const Atom_ptr_vec& atoms);
+			// copies in the current positions, charges and molecule IDs of the assigned atoms
+			void Update ();
+
+			int size () const { return _size; }
+			int Padded () const { return (int)_x.size(); }
+
+			// the coordinates are kept in coord_real precision, as for the other packed position copies (see vecr.h)
+			const coord_real * X () const { return &_x[0]; }
+			const coord_real * Y () const { return &_y[0]; }
+			const coord_real * Z () const { return &_z[0]; }
+			const coord_real * Coordinates (const coord axis) const { return (axis == x) ? &_x[0] : (axis == y) ? &_y[0] : &_z[0]; }
+			VecR Position (const int i) const { return VecR (_x[i], _y[i], _z[i]); }
+
+			const Atom::Element_t * Elements () const { return &_elements[0]; }
+			const double * Masses () const { return &_masses[0]; }
+			const double * Charges () const { return &_charges[0]; }
+			const int * MolIDs () const { return &_molids[0]; }
+
+			AtomPtr Atoms (const int i) const { return _atoms[i]; }
+			// where the atom sits in the store - -1 if it wasn't assigned
+			int Index (const AtomPtr atom) const {
+				const int id = atom->ID();
+				return (id >= 0 && id < (int)_index.size() && _index[id] >= 0 && _atoms[_index[id]] == atom) ? _index[id] : -1;
+			}
+
+		protected:
+			typedef std::vector<double, Eigen::aligned_allocator<double> >	aligned_vec;
+			typedef std::vector<coord_real, Eigen::aligned_allocator<coord_real> >	coord_vec;
+
+			Atom_ptr_vec	_atoms;
+			int						_size;
+
+			coord_vec			_x, _y, _z;
+			aligned_vec		_masses, _charges;
+			std::vector<Atom::Element_t>	_elements;
+			std::vector<int>	_molids;
+
+			std::vector<int>	_index;		// store entry of each atom, by atom ID
+	};	// atom store
+
+}	// namespace md system
+
+#endif
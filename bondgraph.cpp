@@ -1,4 +1,5 @@
 #include "bondgraph.h"
+#include "threading.h"
 
 namespace bondgraph {
 	BondGraph::graph_t BondGraph::_graph (0);
@@ -12,6 +13,8 @@ namespace bondgraph {
 	BondGraph::PropertyMap<Atom::Element_t,BondGraph::VertexProperties>::Type BondGraph::v_elmt = get(&VertexProperties::element, _graph);
 	BondGraph::PropertyMap<AtomPtr,BondGraph::VertexProperties>::Type BondGraph::v_parent = get(&VertexProperties::parent, _graph);
 
+	const BondGraph * BondGraph::_graph_owner = (BondGraph *)NULL;
+
 
 	/*
 	BondGraph::BondGraph () :
@@ -20,9 +23,9 @@ namespace bondgraph {
 		}
 		*/
 
-	BondGraph::BondGraph () { }
+	BondGraph::BondGraph () : _graph_current(false), _num_threads(1), _skin(0.0) { }
 
-	BondGraph::BondGraph (const Atom_ptr_vec& atoms) {
+	BondGraph::BondGraph (const Atom_ptr_vec& atoms) : _graph_current(false), _num_threads(1), _skin(0.0) {
 		this->UpdateGraph(atoms);
 		return;
 	}
@@ -32,23 +35,33 @@ namespace bondgraph {
 	BondGraph::~BondGraph () {
 		//this->_ClearBonds();
 		//this->_ClearAtoms();
+		if (_graph_owner == this)
+			_graph_owner = (BondGraph *)NULL;
 		return;
 	}
 
 
 	void BondGraph::_ParseAtoms (Atom_it first, Atom_it last) {
 		// set all the vertices to contain the proper info
-		//std::cout << "bondgraph::parseatoms " << last - first << std::endl;
-		Vertex v;
-		int i = 0;
-		for (Atom_it it = first; it != last; it++) {
-			v = boost::vertex(i, _graph);
-			v_atom[v] = *it;
-			v_position[v] = (*it)->Position();
-			v_elmt[v] = (*it)->Element();
-			i++;
-		}
-		//std::cout << "bondgraph::parseatoms " << last - first << std::endl;
+		_atoms.assign(first, last);
+		_positions.resize(3*_atoms.size());
+
+		int max_id = -1;
+		for (unsigned int i = 0; i < _atoms.size(); i++) {
+			const vector_map& position = _atoms[i]->Position();
+			_positions[3*i] = (coord_real)position[x];
+			_positions[3*i+1] = (coord_real)position[y];
+			_positions[3*i+2] = (coord_real)position[z];
+			if (_atoms[i]->ID() > max_id)
+				max_id = _atoms[i]->ID();
+		}
+
+		// atoms are looked up by their IDs. Atoms without an ID are found by searching through the vertices instead.
+		_vertex_ids.assign(max_id+1, -1);
+		for (unsigned int i = 0; i < _atoms.size(); i++) {
+			if (_atoms[i]->ID() >= 0)
+				_vertex_ids[_atoms[i]->ID()] = i;
+		}
 
 		return;
 	}
@@ -65,120 +78,36 @@ namespace bondgraph {
 		// first clear out all the bonds from before
 		this->_ClearBonds();
 
-		// now run through all atom combos and get their bondlengths in order to set their bondtypes
-		AtomPtr ai, aj;
-
-		// this little for-loop bit runs through all atom-pair combinations once and find the bond-types between them
-		Vertex_it vi, vi_end, next_i;
-		tie(vi, vi_end) = vertices(_graph);
-		Vertex_it vj, vj_end, next_j;
-		tie(vj, vj_end) = vertices(_graph);
-
-		--vi_end;
-		for (next_i = vi; vi != vi_end; vi = next_i) {
-			++next_i;
-			vj = next_i;
-			for (next_j = vj; vj != vj_end; vj = next_j) {
-				++next_j;
-
-				ai = v_atom[*vi];	// first atom
-				aj = v_atom[*vj];	// second atom
-				// Don't connect oxygens to oxygens, and hydrogen to hydrogen...etc.
-				//if (Atom::element_eq(ai,aj)) continue;
-
-				// calculate the distance between the two atoms (taking into account the periodic boundaries)
-				double bondlength = MDSystem::Distance (v_position[*vi], v_position[*vj]).Magnitude();
-				if (bondlength > HBONDLENGTH && bondlength > SOINTERACTIONLENGTH) continue;
-				// all bonds are considered unbound unless proven otherwise
-				bondtype btype = unbonded;
-
-				// first process O-H bonds
-				if (Atom::ElementCombo(ai,aj,Atom::O,Atom::H))
-				{
-					// one type of bond is the O-H covalent
-					if (bondlength <= OHBONDLENGTH) {
-						btype = covalent;
-					}
-
-					// Or check if an H-bond is formed
-					else if (bondlength <= HBONDLENGTH) {
-#ifdef ANGLE_CRITERIA
-						// additionally, let's check the angle-criteria for an H-bond.
-						// This is done by looking at the angle formed from
-						// o1 is covalently bound to h, and o2 is h-bound to h
-						AtomPtr o1 = (AtomPtr)NULL, h = (AtomPtr)NULL, o2 = (AtomPtr)NULL;	
-
-						if (ai->Element() == Atom::O) {		// ai is the O, and aj is the H
-							o2 = ai;
-							h = aj;
-						}
-						else if (aj->Element() == Atom::O) {
-							o2 = aj;
-							h = ai;
-						}
-
-						o1 = h->ParentMolecule()->GetAtom("O");
-
-						if (h == (AtomPtr)NULL || o1 == (AtomPtr)NULL || o2 == (AtomPtr)NULL) {
-							//throw (MALFORMED_H2O);
-							//printf ("Something wrong in assigning the atoms O and H in forming an H-bond - graph.cpp\n");
-							//exit(1);
-						}
-
-						VecR o1h = MDSystem::Distance (o1, h);	// the covalent bond
-						VecR ho2 = MDSystem::Distance (h, o2);	// the H-bond
-
-						double anglecos = o1h < ho2;		// cos(theta)
-
-						if (anglecos > HBONDANGLECOS){
-							//printf ("% 10.3f / %6.3f\n", acos(angle)*180.0/M_PI, HBONDANGLECOS);
-#endif
-							btype = hbond;
-#ifdef ANGLE_CRITERIA
-						}
-#endif
-					}	// check for h-bond
-
-				}	// Check OH bond combos
-
-
-				// process N-O bonds
-				else if (Atom::ElementCombo (ai,aj, Atom::N, Atom::O) && (bondlength < NOBONDLENGTH)) {
-					btype = covalent;
-				}
-
-				// now process SO2 molecules
-				else if (Atom::ElementCombo (ai,aj, Atom::S, Atom::O)) { 
-					if (bondlength < SOBONDLENGTH) {
-						btype = covalent;
-					} // process S-O covalent bonds
-					else if (bondlength < SOINTERACTIONLENGTH) {
-						btype = interaction;
-					}	// process S-O interactions (sorta h-bonds)
-				}
+		const VecR& box = MDSystem::Dimensions();
+		for (int i = 0; i < 3; i++) {
+			_box[i] = (coord_real)box[i];
+			_half_box[i] = (coord_real)(box[i]/2.0);
+		}
 
-				else if (Atom::ElementCombo (ai,aj, Atom::C, Atom::O)) {
-					if (bondlength < COBONDLENGTH) {
-						btype = covalent;
-					}
-				}
-				else if (Atom::ElementCombo (ai,aj, Atom::C, Atom::H)) {
-					if (bondlength < CHBONDLENGTH) {
-						btype = covalent;
-					}
-				}
-				else if (Atom::ElementCombo (ai,aj, Atom::C, Atom::C)) {
-					if (bondlength < CCBONDLENGTH) {
-						btype = covalent;
-					}
-				}
+		// With the Verlet lists on, the candidate pairs from a previous frame are reused until the atoms have moved too far.
+		if (_skin > 0.0 && this->_VerletListExpired())
+			this->_BuildVerletList();
 
+		if (_num_threads > 1) {
+			this->_ParseBondsThreaded();
+		}
+		else {
+			// find the atom pairs that could possibly be bonded
+			if (_skin <= 0.0)
+				this->_FindAtomPairs (MAXBONDLENGTH, false);
+
+			// the pairs are ordered in the same way as an all-pairs loop, so the bonds are always added in the same order
+			double bondlength;
+			for (std::vector<vertex_pair>::const_iterator it = _pairs.begin(); it != _pairs.end(); it++) {
+				bondtype btype = this->_ParseBond (it->first, it->second, bondlength);
 				// add in the bond between two atoms
 				if (btype != unbonded)
-					this->_SetBond (*vi, *vj, bondlength, btype);
+					this->_SetBond (it->first, it->second, bondlength, btype);
 			}
 		}
 
+		this->_BuildBondTable();
+
 		/*
 		// Now fix up any weird atom-sharing between molecules. At this point we have to consider if we want to divide the system into separate molecules, or if we're interested in other phenomena, such as contact-ion pairs, etc.
 		if (_sys_type == "xyz")
@@ -191,41 +120,347 @@ namespace bondgraph {
 		*/
 	}	// Parse Bonds
 
-	void BondGraph::_ClearBonds () {
-		// Remove all the edges.
-		Edge_it ei, e_end, next;
-		tie(ei, e_end) = edges(_graph);
-		for (next = ei; ei != e_end; ei = next) {
-			next++;
-			remove_edge(*ei, _graph);
+	// pthread-compatible function for running one thread's block of the bond search
+	void * parse_bond_block (void * thread_data) {
+		BondGraph::BondThread * thread = (BondGraph::BondThread *)thread_data;
+		thread->graph->_ParseBondBlock (*thread);
+		pthread_exit(NULL);
+		return NULL;
+	}
+
+	// Each thread finds the bonds formed by its own block of vertices (i.e. the first atom of each pair) or, with the Verlet lists on, its own block of the candidate pairs.
+	void BondGraph::_ParseBondBlock (BondThread& thread) const {
+		thread.records.clear();
+
+		int num = (_skin > 0.0) ? (int)_pairs.size() : (int)_atoms.size();
+		int low = threads::block_low (thread.id, _num_threads, num);
+		int high = threads::block_high (thread.id, _num_threads, num);
+
+		double bondlength;
+		bondtype btype;
+		for (int k = low; k <= high; k++) {
+			if (_skin > 0.0) {
+				btype = this->_ParseBond (_pairs[k].first, _pairs[k].second, bondlength);
+				if (btype != unbonded)
+					thread.records.push_back (BondRecord(_pairs[k].first, _pairs[k].second, bondlength, btype));
+				continue;
+			}
+
+			this->_FindNeighbors (k, MAXBONDLENGTH, false, thread.neighbors);
+			for (std::vector<int>::const_iterator j = thread.neighbors.begin(); j != thread.neighbors.end(); j++) {
+				btype = this->_ParseBond (k, *j, bondlength);
+				if (btype != unbonded)
+					thread.records.push_back (BondRecord(k, *j, bondlength, btype));
+			}
 		}
+
 		return;
 	}
 
-	void BondGraph::_ClearAtoms () {
-		// Remove all the vertices.
-		Vertex_it vi, vi_end, next;
-		tie(vi, vi_end) = vertices(_graph);
-		for (next = vi; vi != vi_end; vi = next) {
-			++next;
-			remove_vertex(*vi, _graph);
+	void BondGraph::_ParseBondsThreaded () {
+		// the atoms are binned up front - the grid is only read by the threads
+		if (_skin <= 0.0)
+			this->_BinAtoms (MAXBONDLENGTH);
+
+		// the thread buffers are kept from one update to the next
+		if ((int)_threads.size() != _num_threads)
+			_threads.resize(_num_threads);
+
+		std::vector<pthread_t> thread_ids (_num_threads);
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+		for (int t = 0; t < _num_threads; t++) {
+			_threads[t].graph = this;
+			_threads[t].id = t;
+			int rc = pthread_create(&thread_ids[t], &attr, parse_bond_block, (void *)&_threads[t]);
+			if (rc) {
+				printf ("BondGraph::_ParseBondsThreaded() - couldn't create bond search thread %d (error code %d)\n", t, rc);
+				exit(1);
+			}
+		}
+
+		for (int t = 0; t < _num_threads; t++) {
+			pthread_join(thread_ids[t], NULL);
+		}
+		pthread_attr_destroy(&attr);
+
+		// the blocks are in vertex (or pair) order, so joining the buffers in thread order keeps the bonds in the same order as the serial search
+		for (int t = 0; t < _num_threads; t++) {
+			_records.insert (_records.end(), _threads[t].records.begin(), _threads[t].records.end());
+		}
+
+		return;
+	}	// Parse bonds threaded
+
+	// bins all the atoms into cells that are at least as wide as the cutoff. Only atoms in neighboring cells can then be bonded.
+	void BondGraph::_BinAtoms (const double cutoff) {
+		int numatoms = (int)_atoms.size();
+		_grid.Reset (MDSystem::Dimensions(), cutoff, numatoms);
+		if (!_grid.Usable()) return;
+
+		_cells.resize(numatoms);
+		for (int i = 0; i < numatoms; i++) {
+			_cells[i] = _grid.Insert (i, this->_Position(i));
 		}
 		return;
 	}
 
-	void BondGraph::UpdateGraph (const Atom_it first, const Atom_it last) {
-		// clear out the old graph info
-		//std::cout << "1 bondgraph::updategraph " << last - first << std::endl;
+	// Gathers up the atoms (j > i) that could be bonded to atom i, in ascending order, so that each pair is processed once and the pairs come out in the same order as an all-pairs loop. If screen is set, only the atoms within the cutoff are kept.
+	// Small systems (or small boxes) don't have enough cells for the grid, so all the atoms are taken instead.
+	void BondGraph::_FindNeighbors (const int i, const double cutoff, const bool screen, std::vector<int>& neighbors) const {
+		neighbors.clear();
+		int numatoms = (int)_atoms.size();
+
+		if (!_grid.Usable()) {
+			for (int j = i+1; j < numatoms; j++) {
+				if (screen && this->_Distance (this->_Position(i), this->_Position(j)) > cutoff) continue;
+				neighbors.push_back (j);
+			}
+			return;
+		}
+
+		int neighbor_cells[27];
+		_grid.Neighbors (_cells[i], neighbor_cells);
+		for (int c = 0; c < 27; c++) {
+			for (int j = _grid.Head(neighbor_cells[c]); j != CellGrid::END; j = _grid.Next(j)) {
+				if (j <= i) continue;
+				if (screen && this->_Distance (this->_Position(i), this->_Position(j)) > cutoff) continue;
+				neighbors.push_back (j);
+			}
+		}
+		std::sort (neighbors.begin(), neighbors.end());
+
+		return;
+	}
+
+	// Gathers up all the atom pairs that are in neighboring cells of a grid with cells as wide as the cutoff. Pairs are ordered by the first and then the second vertex (i < j).
+	// If screen is set, only the pairs that are within the cutoff are kept.
+	void BondGraph::_FindAtomPairs (const double cutoff, const bool screen) {
+		_pairs.clear();
+		this->_BinAtoms (cutoff);
+
+		int numatoms = (int)_atoms.size();
+		for (int i = 0; i < numatoms; i++) {
+			this->_FindNeighbors (i, cutoff, screen, _neighbors);
+			for (std::vector<int>::const_iterator j = _neighbors.begin(); j != _neighbors.end(); j++) {
+				_pairs.push_back (std::make_pair(i, *j));
+			}
+		}
+
+		return;
+	}	// Find atom pairs
+
+	// The Verlet list has to be rebuilt if the atoms in the graph or the system size have changed, or if any atom has moved more than half the skin since the list was built. Otherwise two atoms could have closed in on each other from outside the padded cutoff.
+	bool BondGraph::_VerletListExpired () const {
+		int numatoms = (int)_atoms.size();
+		if ((int)_verlet_atoms.size() != numatoms) return true;
+		if (_verlet_dimensions != MDSystem::Dimensions()) return true;
+
+		double limit = 0.5 * _skin;
+		for (int i = 0; i < numatoms; i++) {
+			if (_verlet_atoms[i] != _atoms[i]) return true;
+			if (this->_Distance (&_verlet_positions[3*i], this->_Position(i)) > limit) return true;
+		}
+		return false;
+	}
+
+	void BondGraph::_BuildVerletList () {
+		this->_FindAtomPairs (MAXBONDLENGTH + _skin, true);
+
+		// record the state of the system at the time the list was built
+		_verlet_atoms.assign(_atoms.begin(), _atoms.end());
+		_verlet_positions.assign(_positions.begin(), _positions.end());
+		_verlet_dimensions = MDSystem::Dimensions();
+
+		return;
+	}	// Build verlet list
+
+	// Each coordinate of a is moved through its periodic images until it's within half a box of b. Done in the precision of the positions, so the float build never touches a double until the length comes out.
+	double BondGraph::_Distance (const coord_real * a, const coord_real * b) const {
+		coord_real d[3];
+		for (int i = 0; i < 3; i++) {
+			coord_real ai = a[i];
+			while (fabs(ai-b[i]) > _half_box[i]) {
+				if (ai < b[i]) ai += _box[i];
+				else 		 ai -= _box[i];
+			}
+			d[i] = b[i] - ai;
+		}
+		return (double)sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+	}
+
+	// determines the type of bond (if any) formed between two atoms. Returns unbonded if the atoms aren't bound.
+	bondtype BondGraph::_ParseBond (const int vi, const int vj, double& bondlength) const {
+
+		AtomPtr ai = _atoms[vi];	// first atom
+		AtomPtr aj = _atoms[vj];	// second atom
+		// Don't connect oxygens to oxygens, and hydrogen to hydrogen...etc.
+		//if (Atom::element_eq(ai,aj)) continue;
+
+		// calculate the distance between the two atoms (taking into account the periodic boundaries)
+		bondlength = this->_Distance (this->_Position(vi), this->_Position(vj));
+		if (bondlength > HBONDLENGTH && bondlength > SOINTERACTIONLENGTH) return unbonded;
+		// all bonds are considered unbound unless proven otherwise
+		bondtype btype = unbonded;
+
+		// first process O-H bonds
+		if (Atom::ElementCombo(ai,aj,Atom::O,Atom::H))
+		{
+			// one type of bond is the O-H covalent
+			if (bondlength <= OHBONDLENGTH) {
+				btype = covalent;
+			}
+
+			// Or check if an H-bond is formed
+			else if (bondlength <= HBONDLENGTH) {
+#ifdef ANGLE_CRITERIA
+				// additionally, let's check the angle-criteria for an H-bond.
+				// This is done by looking at the angle formed from
+				// o1 is covalently bound to h, and o2 is h-bound to h
+				AtomPtr o1 = (AtomPtr)NULL, h = (AtomPtr)NULL, o2 = (AtomPtr)NULL;	
+
+				if (ai->Element() == Atom::O) {		// ai is the O, and aj is the H
+					o2 = ai;
+					h = aj;
+				}
+				else if (aj->Element() == Atom::O) {
+					o2 = aj;
+					h = ai;
+				}
+
+				static const AtomName oxygen ("O");
+				o1 = h->ParentMolecule()->GetAtom(oxygen);
+
+				if (h == (AtomPtr)NULL || o1 == (AtomPtr)NULL || o2 == (AtomPtr)NULL) {
+					//throw (MALFORMED_H2O);
+					//printf ("Something wrong in assigning the atoms O and H in forming an H-bond - graph.cpp\n");
+					//exit(1);
+				}
+
+				VecR o1h = MDSystem::Distance (o1, h);	// the covalent bond
+				VecR ho2 = MDSystem::Distance (h, o2);	// the H-bond
+
+				double anglecos = o1h < ho2;		// cos(theta)
+
+				if (anglecos > HBONDANGLECOS){
+					//printf ("% 10.3f / %6.3f\n", acos(angle)*180.0/M_PI, HBONDANGLECOS);
+#endif
+					btype = hbond;
+#ifdef ANGLE_CRITERIA
+				}
+#endif
+			}	// check for h-bond
+
+		}	// Check OH bond combos
+
+
+		// process N-O bonds
+		else if (Atom::ElementCombo (ai,aj, Atom::N, Atom::O) && (bondlength < NOBONDLENGTH)) {
+			btype = covalent;
+		}
+
+		// now process SO2 molecules
+		else if (Atom::ElementCombo (ai,aj, Atom::S, Atom::O)) { 
+			if (bondlength < SOBONDLENGTH) {
+				btype = covalent;
+			} // process S-O covalent bonds
+			else if (bondlength < SOINTERACTIONLENGTH) {
+				btype = interaction;
+			}	// process S-O interactions (sorta h-bonds)
+		}
 
+		else if (Atom::ElementCombo (ai,aj, Atom::C, Atom::O)) {
+			if (bondlength < COBONDLENGTH) {
+				btype = covalent;
+			}
+		}
+		else if (Atom::ElementCombo (ai,aj, Atom::C, Atom::H)) {
+			if (bondlength < CHBONDLENGTH) {
+				btype = covalent;
+			}
+		}
+		else if (Atom::ElementCombo (ai,aj, Atom::C, Atom::C)) {
+			if (bondlength < CCBONDLENGTH) {
+				btype = covalent;
+			}
+		}
+
+		return btype;
+	}	// Parse Bond
+
+	// Builds the bond table out of the bonds that were found. Each bond is listed under both of its atoms, and the bonds of each atom are kept in the order they were found.
+	void BondGraph::_BuildBondTable () {
+		int numatoms = (int)_atoms.size();
+
+		// count up the bonds of each atom
+		_offsets.assign(numatoms+1, 0);
+		for (std::vector<BondRecord>::const_iterator it = _records.begin(); it != _records.end(); it++) {
+			_offsets[it->i+1]++;
+			_offsets[it->j+1]++;
+		}
+		for (int i = 0; i < numatoms; i++) {
+			_offsets[i+1] += _offsets[i];
+		}
+
+		// then drop each bond into the slots of its two atoms
+		_bonds.resize(_offsets[numatoms]);
+		_fill.assign(_offsets.begin(), _offsets.end()-1);
+		for (std::vector<BondRecord>::const_iterator it = _records.begin(); it != _records.end(); it++) {
+			_bonds[_fill[it->i]++] = Bond (it->distance, _atoms[it->j], it->j, it->btype);
+			_bonds[_fill[it->j]++] = Bond (it->distance, _atoms[it->i], it->i, it->btype);
+		}
+
+		return;
+	}	// Build bond table
+
+	// Copies the atoms and bonds into the boost graph. The bonds are added in the order they were found, so the graph is the same as if it had been built up directly.
+	void BondGraph::_BuildGraph () {
 		_graph.clear();
-		//std::cout << "2 bondgraph::updategraph " << last - first << std::endl;
 
-		// resize the graph with new vertices
-		for (Atom_it it = first; it != last; it++) {
-			boost::add_vertex(_graph);
+		for (unsigned int i = 0; i < _atoms.size(); i++) {
+			Vertex v = boost::add_vertex(_graph);
+			v_atom[v] = _atoms[i];
+			v_position[v] = this->_PositionVector(i);
+			v_elmt[v] = _atoms[i]->Element();
+			v_parent[v] = (AtomPtr)NULL;
+		}
+
+		for (std::vector<BondRecord>::const_iterator it = _records.begin(); it != _records.end(); it++) {
+			add_edge(vertex(it->i, _graph), vertex(it->j, _graph), EdgeProperties(it->distance, it->btype), _graph);
 		}
-		//std::cout << "3 bondgraph::updategraph " << last - first << std::endl;
 
+		_graph_owner = this;
+		_graph_current = true;
+		return;
+	}
+
+	BondGraph::graph_t& BondGraph::Graph () {
+		if (_graph_owner != this || !_graph_current)
+			this->_BuildGraph();
+		return _graph;
+	}
+
+	void BondGraph::_ClearBonds () {
+		// Remove all the edges.
+		_records.clear();
+		_graph_current = false;
+		return;
+	}
+
+	void BondGraph::_ClearAtoms () {
+		// Remove all the vertices.
+		_atoms.clear();
+		_positions.clear();
+		_vertex_ids.clear();
+		_offsets.clear();
+		_bonds.clear();
+		this->_ClearBonds();
+		return;
+	}
+
+	void BondGraph::UpdateGraph (const Atom_it first, const Atom_it last) {
 		// parse the atom info into the vertices
 		this->_ParseAtoms(first, last);
 		// then find all the needed bond information
@@ -245,78 +480,130 @@ namespace bondgraph {
 		return;
 	}
 
-	void BondGraph::_SetBond (const Vertex& vi, const Vertex& vj, const double bondlength, const bondtype btype) {
-		bool b;
-		Edge e;
+	void BondGraph::_SetBond (const int vi, const int vj, const double bondlength, const bondtype btype) {
+		_records.push_back (BondRecord(vi, vj, bondlength, btype));
+		return;
+	}
 
-		tie(e, b) = add_edge(vi, vj, EdgeProperties(bondlength, btype), _graph);
-		/*
-			 if (!b) {
-			 std::cout << "BondGraph::SetBond() - Tried to add a bond to an already-bonded atom pair" << std::endl;
-			 v_atom[vi]->Print();
-			 v_atom[vj]->Print();
-			 exit(1);
-			 }
-			 */
+	int BondGraph::_Vertex (const AtomPtr atom) const {
+		int id = atom->ID();
+		if (id >= 0 && id < (int)_vertex_ids.size()) {
+			int v = _vertex_ids[id];
+			if (v >= 0 && _atoms[v] == atom)
+				return v;
+		}
 
-		return;
+		// the atom has no ID (or shares it with another atom) so it has to be searched for
+		Atom_ptr_vec::const_iterator it = std::find(_atoms.begin(), _atoms.end(), atom);
+		if (it == _atoms.end())
+			return -1;
+		return (int)(it - _atoms.begin());
 	}
 
+	// the vertex iterator of an atom in the boost graph (see Graph()), or the end of the vertices if the atom isn't in the graph
 	BondGraph::Vertex_it BondGraph::_FindVertex (const AtomPtr atom) const {
-		Vertex_it vi, vi_end, next;
-		tie(vi, vi_end) = vertices(_graph);
-		for (next = vi; vi != vi_end; vi = next) {
-			++next;
-			if (v_atom[*vi] == atom)
-				break;
+		int v = this->_Vertex(atom);
+		if (v < 0)
+			v = (int)_atoms.size();
+		return (Vertex_it(v));
+	}
+
+	BondGraph::Bond_range BondGraph::Bonds (const AtomPtr ap) const {
+		int v = this->_Vertex(ap);
+		if (v < 0)
+			return std::make_pair(_bonds.end(), _bonds.end());
+		return std::make_pair(_bonds.begin() + _offsets[v], _bonds.begin() + _offsets[v+1]);
+	}
+
+	// The bonds are found in order of their vertex pairs (see _FindNeighbors), so the list comes out sorted.
+	void BondGraph::BondPairs (std::vector<vertex_pair>& pairs, const bondtype btype) const {
+		pairs.clear();
+		for (std::vector<BondRecord>::const_iterator it = _records.begin(); it != _records.end(); it++) {
+			if (it->btype == btype)
+				pairs.push_back (std::make_pair(it->i, it->j));
+		}
+		return;
+	}
+
+	// A union-find pass over the bonds. Each set is rooted at its lowest vertex, so a vertex's parent always comes before it, and the sets can then be numbered in a single sweep through the vertices.
+	int BondGraph::Components (std::vector<int>& component, const bondtype btype) const {
+		int numatoms = (int)_atoms.size();
+		std::vector<int>& parent = component;	// the union-find parents are kept in the output vector
+		parent.resize(numatoms);
+		for (int i = 0; i < numatoms; i++) {
+			parent[i] = i;
+		}
+
+		for (std::vector<BondRecord>::const_iterator it = _records.begin(); it != _records.end(); it++) {
+			if (it->btype != btype) continue;
+
+			// find the roots of both atoms (halving the paths along the way)
+			int ri = it->i, rj = it->j;
+			while (parent[ri] != ri) {
+				parent[ri] = parent[parent[ri]];
+				ri = parent[ri];
+			}
+			while (parent[rj] != rj) {
+				parent[rj] = parent[parent[rj]];
+				rj = parent[rj];
+			}
+
+			// the lower root becomes the root of the joined set
+			if (ri < rj)
+				parent[rj] = ri;
+			else if (rj < ri)
+				parent[ri] = rj;
 		}
 
-		//Vertex_pair vp = vertices(_graph);
-		//Vertex_it vi, vi_end, atom_vt;
-		// find the vertex
-		//Vertex_it atom_vt = std::find_if (vp.first, vp.second, std::bind2nd(VertexIsAtom_pred(), atom));
-		//tie(vi, vi_end) = vertices(_graph);
+		// parents come before their children, so by the time a vertex is reached its parent has already been given the number of the set
+		int num = 0;
+		for (int i = 0; i < numatoms; i++) {
+			component[i] = (parent[i] == i) ? num++ : component[parent[i]];
+		}
 
-		return (vi);
+		return num;
+	}
+
+	int BondGraph::NumBonds (const AtomPtr ap, const bondtype btype, const Atom::Element_t elmt) const {
+		int num = 0;
+		Bond_range bonds = this->Bonds(ap);
+		for (Bond_it it = bonds.first; it != bonds.second; it++) {
+			if (BondMatches(*it, btype, elmt))
+				++num;
+		}
+		return num;
 	}
 
 	// returns a list of the atoms bonded to the given atom
 	Atom_ptr_vec BondGraph::BondedAtoms (const AtomPtr ap, bondtype const btype, Atom::Element_t const elmt) const {
 		Atom_ptr_vec atoms;
-		Vertex_it va = this->_FindVertex(ap);
-		Edge e;
-
-		Adj_it vi, vi_end, next;
-		tie(vi, vi_end) = adjacent_vertices(*va, _graph);
-		for (next = vi; vi != vi_end; vi = next) {
-			next++;
-
-			// don't check an atom against itself
-			if (v_atom[*va] == v_atom[*vi]) continue;
-
-			// check the bondtype criteria - return only bonds that are specified by the bondtype argument, or if no argument is specified, return all hbond and covalent bonds.
-			e = edge(*va, *vi, _graph).first;
-			if (btype == b_type[e] || ((!btype) && ((b_type[e] == hbond) || (b_type[e] == covalent) || (b_type[e] == interaction)))) {
-		//	if (btype == b_type[e] || (!btype && b_type[e] != unbonded)) {
-				if (!elmt || (v_elmt[*vi] == elmt)) {
-					atoms.push_back(v_atom[*vi]);
-				}
-			}
-		}
-
+		this->BondedAtoms (ap, atoms, btype, elmt);
 		return (atoms);
 	}	// Bonded atoms
 
+	void BondGraph::BondedAtoms (const AtomPtr ap, Atom_ptr_vec& atoms, bondtype const btype, Atom::Element_t const elmt) const {
+		atoms.clear();
+
+		// check the bondtype criteria - return only bonds that are specified by the bondtype argument, or if no argument is specified, return all hbond and covalent bonds.
+		Bond_range bonds = this->Bonds(ap);
+		for (Bond_it it = bonds.first; it != bonds.second; it++) {
+			if (BondMatches(*it, btype, elmt))
+				atoms.push_back(it->atom);
+		}
+
+		return;
+	}
+
 	Atom_ptr_vec BondGraph::InteractingAtoms (const AtomPtr ap) const {
 		return this->BondedAtoms(ap, interaction);
 	}
 
 	int BondGraph::NumInteractions (const AtomPtr ap) const {
-		return (this->InteractingAtoms(ap).size());
+		return this->NumBonds(ap, interaction);
 	}
 
 	int BondGraph::NumHBonds (const AtomPtr ap) const {
-		return (this->BondedAtoms(ap, hbond).size());
+		return this->NumBonds(ap, hbond);
 	}
 
 	int BondGraph::NumHBonds (const WaterPtr wat) const {
@@ -402,24 +689,22 @@ namespace bondgraph {
 	}	// Resolve shared hydrogens
 
 	double BondGraph::Distance (const Vertex& vi, const Vertex& vj) const {
-		bool b;
-		Edge e;
-		tie (e,b) = edge(vi, vj, _graph);
-		if (!b) {
-			printf ("The distance routine was run for the following two atoms, but they were never connected in the graph\n");
-			v_atom[vi]->Print();
-			v_atom[vj]->Print();
-			exit(1);
+		for (int b = _offsets[vi]; b < _offsets[vi+1]; b++) {
+			if (_bonds[b].vertex == (int)vj)
+				return (_bonds[b].distance);
 		}
-		return (b_length[e]);
+
+		printf ("The distance routine was run for the following two atoms, but they were never connected in the graph\n");
+		_atoms[vi]->Print();
+		_atoms[vj]->Print();
+		exit(1);
 	}
 
 	double BondGraph::Distance (const AtomPtr a1, const AtomPtr a2) const {
-		Vertex_it vi, vj;
-		vi = this->_FindVertex (a1);
-		vj = this->_FindVertex (a2);
+		int vi = this->_Vertex (a1);
+		int vj = this->_Vertex (a2);
 
-		return Distance(*vi,*vj);
+		return Distance((Vertex)vi,(Vertex)vj);
 	}
 
 
@@ -454,29 +739,23 @@ namespace bondgraph {
 	distance_vec BondGraph::ClosestAtoms (const AtomPtr atom, const int num, const Atom::Element_t elmt, bool SameMoleculeCheck) const {
 		distance_vec distances;
 
-		// find the distance between the target atom and all the other atoms in the system
-		Vertex_it vt, vi, vi_end, next;
-		vt = _FindVertex (atom);
+		// distances are only known for the atoms that are bonded to the target atom
+		Bond_range bonds = this->Bonds(atom);
+		for (Bond_it it = bonds.first; it != bonds.second; it++) {
 
-		tie(vi, vi_end) = vertices(_graph);
-		for (next = vi; vi != vi_end; vi = next) {
-			++next;
-
-			// don't check the same atom against itself - that's not defined!
-			if (vi == vt) continue;
-
-			// don't consider atoms within the same molecule, or an atom compared to itself
-			if (!SameMoleculeCheck && (v_atom[*vt]->ParentMolecule() == v_atom[*vi]->ParentMolecule() || vt == vi)) continue;
+			// don't consider atoms within the same molecule
+			if (!SameMoleculeCheck && atom->ParentMolecule() == it->atom->ParentMolecule()) continue;
 
 			// do an element check so that only atoms with the (optional) given element type are considered
-			if (!elmt || elmt == v_elmt[*vi]) { 
-				distances.push_back (std::make_pair (Distance(*vt, *vi), v_atom[*vi]));
+			if (!elmt || elmt == it->atom->Element()) { 
+				distances.push_back (std::make_pair (it->distance, it->atom));
 			}
 		}
 
 		// sort all the distances to find the one closest
 		pair_utility::pair_sort_first(distances.begin(), distances.end());
-		distances.erase (distances.begin()+num, distances.end());
+		if ((int)distances.size() > num)
+			distances.erase (distances.begin()+num, distances.end());
 
 		return distances;
 	}
@@ -496,44 +775,4 @@ namespace bondgraph {
 
 		return distances;
 	} // closest Atoms - molecular version
-
-
-
-	BondGraph::Edge BondGraph::_GetBond (const Vertex& vi, const Vertex& vj) const {
-		Edge e;
-		bool b;
-		tie (e,b) = edge(vi, vj, _graph);
-
-		if (!b) {
-			//throw(BOND_NOT_FOUND);
-			/*
-				 printf ("BondGraph::_GetBond - Couldn't find the requested Bond");
-				 exit(1);
-				 */
-		}
-
-		return (e);
-	}	// _Get Bond
-
-	BondGraph::Edge BondGraph::_GetBond (const AtomPtr a1, const AtomPtr a2) const {
-		Vertex_it v1 = this->_FindVertex(a1);
-		Vertex_it v2 = this->_FindVertex(a2);
-		Edge e = this->_GetBond(*v1, *v2);
-
-		return (e);
-	}
-
-	void BondGraph::_RemoveBond (const Vertex& vi, const Vertex& vj) {
-		Edge e = this->_GetBond(vi, vj);
-		remove_edge(e, _graph);
-
-		return;
-	}
-
-	void BondGraph::_RemoveBond (const AtomPtr a1, const AtomPtr a2) {
-		Edge e = this->_GetBond (a1, a2);
-		remove_edge(e, _graph);
-
-		return;
-	}
 }	// namespace bondgraph
@@ -2,6 +2,7 @@
 #define BONDGRAPH_H_
 
 #include "mdsystem.h"
+#include "cellgrid.h"
 #include "utility.h"
 
 #include <map>
@@ -46,6 +47,9 @@ namespace bondgraph {
 	const double CHBONDLENGTH = 1.2;
 	const double CCBONDLENGTH = 1.8;
 
+	// the longest distance at which any type of bond is formed - sets the cell size for the neighbor search
+	const double MAXBONDLENGTH = (HBONDLENGTH > SOINTERACTIONLENGTH) ? HBONDLENGTH : SOINTERACTIONLENGTH;
+
 
 
 	// bond types
@@ -144,20 +148,93 @@ namespace bondgraph {
 			static PropertyMap<Atom::Element_t,VertexProperties>::Type	v_elmt;
 			static PropertyMap<AtomPtr,VertexProperties>::Type		v_parent;
 
+			// One entry of the bond table - the bond as seen from one of its two atoms
+			struct Bond {
+				Bond () { }
+				Bond (const double b_length, const AtomPtr b_atom, const int b_vertex, const bondtype b_type) : distance(b_length), atom(b_atom), vertex(b_vertex), btype(b_type) { }
+				double		distance;	// bond length
+				AtomPtr		atom;			// the atom on the other end of the bond
+				int				vertex;		// ... and its vertex
+				bondtype	btype;
+			};
+			typedef std::vector<Bond> Bond_vec;
+			typedef Bond_vec::const_iterator Bond_it;
+			typedef std::pair<Bond_it, Bond_it> Bond_range;
+
+			// a bond as it is found while parsing the atom pairs (i < j)
+			struct BondRecord {
+				BondRecord (const int vi, const int vj, const double b_length, const bondtype b_type) : i(vi), j(vj), distance(b_length), btype(b_type) { }
+				int				i, j;
+				double		distance;
+				bondtype	btype;
+			};
+
 			void _ParseAtoms (Atom_it first, Atom_it last);
 			void _ParseAtoms (const Atom_ptr_vec& atoms);
 			void _ParseBonds ();
+			bondtype _ParseBond (const int vi, const int vj, double& bondlength) const;
+			void _BinAtoms (const double cutoff);
+			void _FindNeighbors (const int i, const double cutoff, const bool screen, std::vector<int>& neighbors) const;
+			void _FindAtomPairs (const double cutoff, const bool screen);
+			bool _VerletListExpired () const;
+			void _BuildVerletList ();
+			void _BuildBondTable ();
+			void _BuildGraph ();
 			void _ClearBonds ();
 			void _ClearAtoms ();
 			void _ResolveSharedHydrogens ();
 
-			void _SetBond (const Vertex& vi, const Vertex& vj, const double bondlength, const bondtype btype);
-			Edge _GetBond (const Vertex& vi, const Vertex& vj) const;
-			Edge _GetBond (const AtomPtr a1, const AtomPtr a2) const;
-			void _RemoveBond (const Vertex& vi, const Vertex& vj);
-			void _RemoveBond (const AtomPtr a1, const AtomPtr a2);
+			void _SetBond (const int vi, const int vj, const double bondlength, const bondtype btype);
 
+			// Each thread of the bond search works on its own block of vertices (or of Verlet pairs), and keeps the bonds it finds in its own buffer. The buffers are joined in thread order afterwards, which gives the same bonds in the same order as the serial search.
+			struct BondThread {
+				const BondGraph *	graph;
+				int								id;
+				std::vector<BondRecord>	records;
+				std::vector<int>	neighbors;
+			};
+			void _ParseBondBlock (BondThread& thread) const;
+			void _ParseBondsThreaded ();
+
+			// the boost graph is shared by all the bondgraphs, and is only filled in from the bond table when it is asked for (see Graph())
 			static graph_t _graph;
+			static const BondGraph * _graph_owner;	// the bondgraph whose bonds are currently in _graph
+			bool _graph_current;	// set once the bonds of this bondgraph have been copied into _graph
+
+			// the atoms (vertices) of the graph, and their positions packed 3 to a vertex (see coord_real for the precision)
+			Atom_ptr_vec					_atoms;
+			std::vector<coord_real>	_positions;
+			std::vector<int>			_vertex_ids;	// maps an atom's ID to its vertex (-1 if the atom isn't in the graph)
+
+			const coord_real * _Position (const int v) const { return &_positions[3*v]; }
+			VecR _PositionVector (const int v) const { return VecR (_positions[3*v], _positions[3*v+1], _positions[3*v+2]); }
+
+			// the periodic box (and half of it) in the precision of the positions, set when the bonds are parsed
+			coord_real	_box[3], _half_box[3];
+			// the distance between two packed positions, taking the periodic boundaries into account as MDSystem::Distance does
+			double _Distance (const coord_real * a, const coord_real * b) const;
+
+			// Bonds are stored in compressed sparse-row form - the bonds of vertex v are _bonds[_offsets[v]] through _bonds[_offsets[v+1]-1], and each bond is listed once for each of its atoms.
+			std::vector<BondRecord>	_records;		// the bonds in the order they were found
+			std::vector<int>			_offsets;
+			Bond_vec							_bonds;
+			std::vector<int>			_fill;			// scratch space for filling in the bond table
+
+			CellGrid _grid;		// spatial binning of the vertices for finding nearby atom pairs
+			std::vector<int>	_cells;			// the grid cell of each vertex
+			std::vector<int>	_neighbors;	// scratch space for the neighbors of a vertex
+
+			int		_num_threads;		// number of threads used to find the bonds
+			std::vector<BondThread>	_threads;
+
+			typedef std::pair<int,int> vertex_pair;
+			std::vector<vertex_pair>	_pairs;	// candidate atom pairs (i < j) to be checked for bonds
+
+			// Verlet neighbor lists - the candidate pairs are found using a cutoff padded by the skin, and are kept until an atom moves more than half the skin
+			double				_skin;					// set to zero to find the pairs anew every time the graph is updated
+			Atom_ptr_vec	_verlet_atoms;	// the atoms used to build the current list
+			std::vector<coord_real>	_verlet_positions;	// atom positions when the list was built
+			VecR					_verlet_dimensions;	// system size when the list was built
 
 
 			// constructor builds the matrix based on number of atoms to analyze
@@ -165,17 +242,69 @@ namespace bondgraph {
 			BondGraph (const Atom_ptr_vec& atoms);
 			~BondGraph ();
 
-			graph_t& Graph() { return _graph; }
+			// the boost graph of the bonds, for use with the boost graph algorithms (e.g. breadth-first search)
+			graph_t& Graph();
 
 			void UpdateGraph (Atom_it, Atom_it);
 			void UpdateGraph (const Atom_ptr_vec&);
 
+			// turns on the Verlet neighbor lists with the given skin thickness (zero turns them off)
+			void VerletSkin (const double skin) { _skin = skin; _verlet_atoms.clear(); }
+			double VerletSkin () const { return _skin; }
+
+			// sets the number of threads used to find the bonds when the graph is updated
+			void NumThreads (const int num) { _num_threads = (num > 1) ? num : 1; }
+			int NumThreads () const { return _num_threads; }
+
+			int NumAtoms () const { return (int)_atoms.size(); }
+			int NumBonds () const { return (int)_records.size(); }
+
+			// the vertex of an atom, or -1 if the atom isn't in the graph
+			int _Vertex (const AtomPtr atom) const;
+
+			// all the bonds formed by an atom (an empty range if the atom isn't in the graph)
+			Bond_range Bonds (const AtomPtr ap) const;
+			Bond_range VertexBonds (const int v) const { return std::make_pair(_bonds.begin() + _offsets[v], _bonds.begin() + _offsets[v+1]); }
+
+			// lists the vertex pairs (i < j) joined by bonds of the given type, in order of the first and then the second vertex
+			void BondPairs (std::vector<vertex_pair>& pairs, const bondtype btype = covalent) const;
+
+			// Labels each vertex with the connected component (i.e. group of atoms joined by bonds of the given type) that it belongs to. Components are numbered in the order of their first vertex. Returns the number of components.
+			int Components (std::vector<int>& component, const bondtype btype = covalent) const;
+
+			// checks a bond against the bondtype and element criteria used for the bond queries. With no bondtype given, hbonds, covalent bonds and interactions all match.
+			static bool BondMatches (const Bond& bond, const bondtype btype, const Atom::Element_t elmt) {
+				return (btype == bond.btype || ((!btype) && ((bond.btype == hbond) || (bond.btype == covalent) || (bond.btype == interaction))))
+					&& (!elmt || (bond.atom->Element() == elmt));
+			}
+
+			// calls visitor(bond) on each of the atom's bonds that match the criteria
+			template <class Visitor>
+				void VisitBonds (const AtomPtr ap, Visitor& visitor, const bondtype btype = null, const Atom::Element_t elmt = Atom::NO_ELEMENT) const {
+					Bond_range bonds = this->Bonds(ap);
+					for (Bond_it it = bonds.first; it != bonds.second; it++) {
+						if (BondMatches(*it, btype, elmt))
+							visitor(*it);
+					}
+				}
+
+			// number of the atom's bonds that match the criteria
+			int NumBonds (const AtomPtr ap, const bondtype btype = null, const Atom::Element_t elmt = Atom::NO_ELEMENT) const;
+
 			Atom_ptr_vec BondedAtoms (
 					const AtomPtr ap,
 					const bondtype btype = null,
 					const Atom::Element_t elmt = Atom::NO_ELEMENT
 					) const;
 
+			// same as above, but the atoms are placed into the given container (which is cleared first)
+			void BondedAtoms (
+					const AtomPtr ap,
+					Atom_ptr_vec& atoms,
+					const bondtype btype = null,
+					const Atom::Element_t elmt = Atom::NO_ELEMENT
+					) const;
+
 			Atom_ptr_vec InteractingAtoms ( const AtomPtr ap) const;
 
 			Vertex_it _FindVertex (const AtomPtr atom) const;
@@ -185,7 +314,7 @@ namespace bondgraph {
 			// returns a distance pair - [distance, AtomPtr]
 			distance_pair ClosestAtom (const AtomPtr, const Atom::Element_t = Atom::NO_ELEMENT, bool = false) const;
 
-			// find the atoms that are closest to an atom
+			// find the atoms that are closest to an atom. Only the atoms bonded to it in the graph are considered.
 			distance_vec ClosestAtoms (const AtomPtr, const int = 1, const Atom::Element_t = Atom::NO_ELEMENT, bool = false) const;
 
 			// find the atoms closest to a given molecule
@@ -0,0 +1,87 @@
+#include "cellgrid.h"
+
+namespace md_system {
+
+	const int CellGrid::END;
+
+	CellGrid::CellGrid () : _usable(false) {
+		_n[0] = _n[1] = _n[2] = 0;
+	}
+
+	void CellGrid::Reset (const VecR& size, const double cutoff, const int num) {
+		_size = size;
+		_usable = true;
+
+		for (int i = 0; i < 3; i++) {
+			// a small margin on the cutoff keeps round-off from letting two members within the cutoff land 2 cells apart
+			_n[i] = (cutoff > 0.0) ? (int)floor(_size[i] / (cutoff + 1.0e-6)) : 0;
+			if (_n[i] < 3) {
+				_usable = false;
+			}
+		}
+
+		_head.clear();
+		_next.assign(num, END);
+		if (_usable)
+			_head.assign(this->NumCells(), END);
+
+		return;
+	}
+
+	// position is anything that can be indexed by axis
+	template <class P>
+		static int cell_of (const P& position, const VecR& size, const int * n) {
+			int c[3];
+			for (int i = 0; i < 3; i++) {
+				// wrap the coordinate into the box, and find the cell along this axis
+				double s = position[i] / size[i];
+				s -= floor(s);
+				c[i] = (int)(s * n[i]);
+				if (c[i] >= n[i]) c[i] = n[i] - 1;
+				if (c[i] < 0) c[i] = 0;
+			}
+			return (c[0]*n[1] + c[1])*n[2] + c[2];
+		}
+
+	int CellGrid::Cell (const VecR& position) const {
+		return cell_of (position, _size, _n);
+	}
+
+	int CellGrid::Cell (const coord_real * position) const {
+		return cell_of (position, _size, _n);
+	}
+
+	int CellGrid::Insert (const int index, const VecR& position) {
+		int cell = this->Cell(position);
+		_next[index] = _head[cell];
+		_head[cell] = index;
+		return cell;
+	}
+
+	int CellGrid::Insert (const int index, const coord_real * position) {
+		int cell = this->Cell(position);
+		_next[index] = _head[cell];
+		_head[cell] = index;
+		return cell;
+	}
+
+	void CellGrid::Neighbors (const int cell, int * cells) const {
+		int cz = cell % _n[2];
+		int cy = (cell / _n[2]) % _n[1];
+		int cx = cell / (_n[1]*_n[2]);
+
+		int i = 0;
+		for (int dx = -1; dx <= 1; dx++) {
+			int nx = (cx + dx + _n[0]) % _n[0];
+			for (int dy = -1; dy <= 1; dy++) {
+				int ny = (cy + dy + _n[1]) % _n[1];
+				for (int dz = -1; dz <= 1; dz++) {
+					int nz = (cz + dz + _n[2]) % _n[2];
+					cells[i++] = (nx*_n[1] + ny)*_n[2] + nz;
+				}
+			}
+		}
+		return;
+	}
+
+}	// namespace md system
@@ -0,0 +1,57 @@
+#ifndef CELLGRID_H_
+#define CELLGRID_H_
+
+#include "vecr.h"
+#include <vector>
+#include <cmath>
+
+namespace md_system {
+
+	/* A periodic linked-cell grid for neighbor searching.
+
+		 The box is divided into cells that are at least as wide as a given cutoff. Any two members that are within the cutoff of each other (taking the periodic boundaries into account) then sit in the same cell or in one of the 26 cells surrounding it. Members are stored as a linked list per cell - Head(cell) gives the first member of a cell, and Next(member) walks the rest of that cell until END is reached.
+
+		 When the box is too small to hold at least 3 cells along an axis the neighboring cells would wrap back onto themselves, and the grid is flagged as not usable. Callers should then fall back to checking all pairs.
+	 */
+	class CellGrid {
+
+		public:
+
+			CellGrid ();
+
+			static const int END = -1;
+
+			// sets up the cells for a periodic box of the given size, and clears out the members. Space is made for num members (indexed from 0 to num-1)
+			void Reset (const VecR& size, const double cutoff, const int num);
+
+			// bins a member into the grid, and returns the cell it was placed in
+			int Insert (const int index, const VecR& position);
+
+			// the cell that a given position falls into (positions are wrapped into the box first)
+			int Cell (const VecR& position) const;
+
+			// the same for a position packed as 3 values (e.g. the bondgraph's coord_real positions), which saves building a VecR for each member
+			int Insert (const int index, const coord_real * position);
+			int Cell (const coord_real * position) const;
+
+			// fills cells with the 27 cell indices surrounding (and including) the given cell
+			void Neighbors (const int cell, int * cells) const;
+
+			int Head (const int cell) const { return _head[cell]; }
+			int Next (const int index) const { return _next[index]; }
+
+			bool Usable () const { return _usable; }
+			int NumCells () const { return _n[0]*_n[1]*_n[2]; }
+
+		protected:
+			VecR				_size;			// box dimensions
+			int					_n[3];			// number of cells along each axis
+			bool				_usable;		// set if there are enough cells along each axis to use the grid
+
+			std::vector<int>	_head;		// first member of each cell
+			std::vector<int>	_next;		// next member in the same cell as a given member
+	};	// cell grid
+
+}	// namespace md system
+
+#endif
@@ -1,17 +1,270 @@
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "threading.h"
+#include "topfile.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-int main () {
+/* Converts the text Amber trajectory (mdcrd) into the binary floats read by CRDFile (mdcrd.bin).
 
-	FILE * fp = fopen ("mdcrd", "r");
-	FILE * wp = fopen ("mdcrd.bin", "wb");
-	float d;
-	while (fscanf (fp, " %f ", &d) != EOF) {
-		fwrite(&d, sizeof(float), 1, wp);
+	 Amber writes the coordinates as 10F8.3 - ten 8-character fields to a line, the last line of each frame cut short - and periodic systems follow each frame with a line of three more fields holding the box. Every frame is then the same number of bytes, so the file is split among the threads at frame boundaries without having to scan it, and every field is read straight from its place in the line. The layout of each frame (including the box line) is checked as it's converted.
+
+	 usage: convertmdcrd [threads]		- reads prmtop and mdcrd, writes mdcrd.bin
+	 Build with: $(CXX) convertmdcrd.cpp topfile.cpp -lpthread -o convertmdcrd */
+
+static const int FIELD_WIDTH = 8;
+static const int FIELDS_PER_LINE = 10;
+static const int BOX_FIELDS = 3;
+// frames converted by a thread between writes
+static const int BATCH_FRAMES = 64;
+
+struct mdcrd_t {
+	const char *	map;
+	size_t				size;
+	size_t				title;					// bytes of the title line at the top of the file
+	int						values;					// coordinate values in a frame (3 per atom)
+	bool					periodic;
+	size_t				frame_bytes;		// text bytes of a frame
+	size_t				frame_floats;		// floats written for each frame
+	int						frames;
+	int						output;
+};
+
+struct convert_thread_t {
+	const mdcrd_t *	mdcrd;
+	int							id;
+	int							num_threads;
+	int							bad_frame;			// the first frame that wasn't laid out as expected (-1 if none)
+	int							bad_fields;			// fields that weren't in F8.3 form (e.g. the asterisks of an overflowed value)
+};
+
+/* An F8.3 field is up to four integer digits (with any sign and padding in front), the point, and three decimals. Reading the digits by position gives the value in thousandths exactly, and the one division rounds it to float the same way fscanf does. Anything else goes to strtod */
+static inline float parse_field (const char * field, int& bad_fields) {
+	if (field[4] == '.') {
+		int value = 0;
+		bool negative = false, valid = true;
+		for (int i = 0; i < FIELD_WIDTH; i++) {
+			const char c = field[i];
+			if (c >= '0' && c <= '9') value = value * 10 + (c - '0');
+			else if (c == '-') negative = true;
+			else if (c != ' ' && i != 4) valid = false;
+		}
+		if (valid)
+			return (float)(negative ? -(value / 1000.0) : value / 1000.0);
+	}
+
+	char buffer[FIELD_WIDTH+1];
+	memcpy (buffer, field, FIELD_WIDTH);
+	buffer[FIELD_WIDTH] = '\0';
+	++bad_fields;
+	return (float)strtod (buffer, (char **)NULL);
+}
+
+#ifdef __SSE2__
+/* Two fields at once. The digits are picked out of the 16 characters and weighted by their place: the first multiply-add pairs them up into 2-digit groups, the second into the integer and decimal parts of each field */
+static inline void parse_fields (const char * fields, float * values, int& bad_fields) {
+	const __m128i chars = _mm_loadu_si128 ((const __m128i *)fields);
+	const __m128i digits = _mm_sub_epi8 (chars, _mm_set1_epi8('0'));
+	const __m128i is_digit = _mm_and_si128 (_mm_cmpgt_epi8 (digits, _mm_set1_epi8(-1)), _mm_cmplt_epi8 (digits, _mm_set1_epi8(10)));
+	const __m128i is_minus = _mm_cmpeq_epi8 (chars, _mm_set1_epi8('-'));
+	const __m128i is_blank = _mm_cmpeq_epi8 (chars, _mm_set1_epi8(' '));
+	const __m128i is_point = _mm_cmpeq_epi8 (chars, _mm_set1_epi8('.'));
+
+	const int points = _mm_movemask_epi8 (is_point);
+	const int known = _mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128 (is_digit, is_minus), _mm_or_si128 (is_blank, is_point)));
+	if (points != 0x1010 || known != 0xffff) {
+		values[0] = parse_field (fields, bad_fields);
+		values[1] = parse_field (fields + FIELD_WIDTH, bad_fields);
+		return;
+	}
+
+	const __m128i d = _mm_and_si128 (digits, is_digit);
+	const __m128i zero = _mm_setzero_si128 ();
+	// digit pairs: (0,1) (2,3) (-,5) (6,7) of each field
+	const __m128i pair_weights = _mm_setr_epi16 (10, 1, 10, 1, 0, 1, 10, 1);
+	const __m128i lo = _mm_madd_epi16 (_mm_unpacklo_epi8 (d, zero), pair_weights);
+	const __m128i hi = _mm_madd_epi16 (_mm_unpackhi_epi8 (d, zero), pair_weights);
+	// integer part (0-9999) and thousandths (0-999) of each field
+	const __m128i parts = _mm_madd_epi16 (_mm_packs_epi32 (lo, hi), _mm_setr_epi16 (100, 1, 100, 1, 100, 1, 100, 1));
+
+	int p[4];
+	_mm_storeu_si128 ((__m128i *)p, parts);
+	const int minus = _mm_movemask_epi8 (is_minus);
+	const int first = p[0] * 1000 + p[1];
+	const int second = p[2] * 1000 + p[3];
+	// the sign goes on last so that -0.000 stays negative, as with fscanf
+	values[0] = (float)((minus & 0x00ff) ? -(first / 1000.0) : first / 1000.0);
+	values[1] = (float)((minus & 0xff00) ? -(second / 1000.0) : second / 1000.0);
+	return;
+}
+#else
+static inline void parse_fields (const char * fields, float * values, int& bad_fields) {
+	values[0] = parse_field (fields, bad_fields);
+	values[1] = parse_field (fields + FIELD_WIDTH, bad_fields);
+}
+#endif
+
+// reads a line of num fields, and checks that it ends where it should
+static inline bool parse_line (const char *& line, const int num, float * values, int& bad_fields) {
+	int i = 0;
+	for (; i + 2 <= num; i += 2)
+		parse_fields (line + i * FIELD_WIDTH, values + i, bad_fields);
+	if (i < num)
+		values[i] = parse_field (line + i * FIELD_WIDTH, bad_fields);
+
+	line += num * FIELD_WIDTH;
+	return *line++ == '\n';
+}
+
+// converts one frame of text into floats - false if the frame isn't laid out as expected
+static bool parse_frame (const mdcrd_t& mdcrd, const char * text, float * values, int& bad_fields) {
+	for (int v = 0; v < mdcrd.values; v += FIELDS_PER_LINE) {
+		const int num = std::min(FIELDS_PER_LINE, mdcrd.values - v);
+		if (!parse_line (text, num, values + v, bad_fields))
+			return false;
+	}
+	if (mdcrd.periodic)
+		return parse_line (text, BOX_FIELDS, values + mdcrd.values, bad_fields);
+	return true;
+}
+
+// pthread-compatible function to convert one thread's block of frames
+void * convert_frames (void * thread_data) {
+	convert_thread_t * thread = (convert_thread_t *)thread_data;
+	const mdcrd_t& mdcrd = *thread->mdcrd;
+
+	const int low = threads::block_low (thread->id, thread->num_threads, mdcrd.frames);
+	const int high = threads::block_high (thread->id, thread->num_threads, mdcrd.frames);
+	std::vector<float> batch (BATCH_FRAMES * mdcrd.frame_floats);
+
+	for (int first = low; first <= high && thread->bad_frame < 0; first += BATCH_FRAMES) {
+		const int frames = std::min(BATCH_FRAMES, high - first + 1);
+		for (int f = 0; f < frames; f++) {
+			const char * text = mdcrd.map + mdcrd.title + (size_t)(first + f) * mdcrd.frame_bytes;
+			if (!parse_frame (mdcrd, text, &batch[f * mdcrd.frame_floats], thread->bad_fields)) {
+				thread->bad_frame = first + f;
+				break;
+			}
+		}
+		if (thread->bad_frame >= 0) break;
+
+		const size_t bytes = frames * mdcrd.frame_floats * sizeof(float);
+		const off_t offset = (off_t)first * mdcrd.frame_floats * sizeof(float);
+		if (pwrite (mdcrd.output, &batch[0], bytes, offset) != (ssize_t)bytes) {
+			printf ("convertmdcrd - couldn't write frames %d-%d to mdcrd.bin\n", first, first + frames - 1);
+			exit(1);
+		}
+	}
+
+	pthread_exit(NULL);
+	return NULL;
+}
+
+// bytes taken up by a line of num fields
+static size_t line_bytes (const int num) { return num * FIELD_WIDTH + 1; }
+
+int main (int argc, char **argv) {
+
+	int num_threads = (argc > 1) ? atoi(argv[1]) : 1;
+	if (num_threads < 1) num_threads = 1;
+
+	md_files::TOPFile top ("prmtop");
+	mdcrd_t mdcrd;
+	mdcrd.values = 3 * top.NumAtoms();
+
+	int fd = open ("mdcrd", O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat (fd, &st) || st.st_size == 0) {
+		printf ("convertmdcrd - couldn't open the mdcrd file\n");
+		exit(1);
+	}
+	void * map = mmap (NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		printf ("convertmdcrd - couldn't map the mdcrd file into memory\n");
+		exit(1);
+	}
+	mdcrd.map = (const char *)map;
+	mdcrd.size = (size_t)st.st_size;
+	madvise ((void *)mdcrd.map, mdcrd.size, MADV_SEQUENTIAL);
+
+	// the title line
+	const char * newline = (const char *)memchr (mdcrd.map, '\n', mdcrd.size);
+	if (newline == (const char *)NULL) {
+		printf ("convertmdcrd - the mdcrd file doesn't hold any frames\n");
+		exit(1);
+	}
+	mdcrd.title = newline + 1 - mdcrd.map;
+
+	size_t coord_bytes = (mdcrd.values / FIELDS_PER_LINE) * line_bytes(FIELDS_PER_LINE);
+	if (mdcrd.values % FIELDS_PER_LINE)
+		coord_bytes += line_bytes(mdcrd.values % FIELDS_PER_LINE);
+
+	// the line after the first frame's coordinates is either the box (three fields) or the start of the next frame
+	const size_t after = mdcrd.title + coord_bytes;
+	const size_t box_bytes = line_bytes(BOX_FIELDS);
+	mdcrd.periodic = after + box_bytes <= mdcrd.size && mdcrd.map[after + box_bytes - 1] == '\n'
+		&& memchr (mdcrd.map + after, '\n', box_bytes - 1) == NULL;
+
+	mdcrd.frame_bytes = coord_bytes + (mdcrd.periodic ? box_bytes : 0);
+	mdcrd.frame_floats = mdcrd.values + (mdcrd.periodic ? BOX_FIELDS : 0);
+	mdcrd.frames = (int)((mdcrd.size - mdcrd.title) / mdcrd.frame_bytes);
+
+	printf ("Converting mdcrd to mdcrd.bin: %d atoms, %s, %d frames of %zu bytes (%zu floats each)\n", top.NumAtoms(), mdcrd.periodic ? "periodic box after each frame" : "no box", mdcrd.frames, mdcrd.frame_bytes, mdcrd.frame_floats);
+	if ((mdcrd.size - mdcrd.title) % mdcrd.frame_bytes)
+		printf ("\tthe last %zu bytes of mdcrd don't make up a full frame and are left out\n", (mdcrd.size - mdcrd.title) % mdcrd.frame_bytes);
+
+	mdcrd.output = open ("mdcrd.bin", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (mdcrd.output < 0) {
+		printf ("convertmdcrd - couldn't open mdcrd.bin for writing\n");
+		exit(1);
+	}
+
+	std::vector<convert_thread_t> thread_data (num_threads);
+	std::vector<pthread_t> thread_ids (num_threads);
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+	for (int t = 0; t < num_threads; t++) {
+		thread_data[t].mdcrd = &mdcrd;
+		thread_data[t].id = t;
+		thread_data[t].num_threads = num_threads;
+		thread_data[t].bad_frame = -1;
+		thread_data[t].bad_fields = 0;
+		int rc = pthread_create(&thread_ids[t], &attr, convert_frames, (void *)&thread_data[t]);
+		if (rc) {
+			printf ("convertmdcrd - couldn't create conversion thread %d (error code %d)\n", t, rc);
+			exit(1);
+		}
+	}
+	for (int t = 0; t < num_threads; t++) {
+		pthread_join(thread_ids[t], NULL);
+	}
+	pthread_attr_destroy(&attr);
+
+	int bad_fields = 0;
+	for (int t = 0; t < num_threads; t++) {
+		bad_fields += thread_data[t].bad_fields;
+		if (thread_data[t].bad_frame >= 0) {
+			printf ("convertmdcrd - frame %d of mdcrd isn't laid out as 10F8.3 with %d values%s\n", thread_data[t].bad_frame, mdcrd.values, mdcrd.periodic ? " and a box line" : "");
+			exit(1);
+		}
 	}
+	if (bad_fields)
+		printf ("\t%d values weren't in F8.3 form (e.g. overflowed fields written as asterisks)\n", bad_fields);
 
-	fclose(fp);
-	fclose(wp);
+	close (mdcrd.output);
+	munmap ((void *)mdcrd.map, mdcrd.size);
+	close (fd);
 
 	return 0;
 }
@@ -3,8 +3,16 @@
 #include <cstring>
 #include <string>
 #include <iostream>
+#include "arcadefile.h"
 
-int main () {
+/* With --arcade the xyz file (and the wanniers and xyz.top files if they're around) are packed into a single arcade container, xyz.arc, rather than xyz.bin. The box of the system can be given after the flag (e.g. --arcade 12.42 12.42 40.0) and is stored with every frame.
+	 Build with: $(CXX) convertxyz.cpp arcadefile.cpp gzipfile.cpp moltopologyfile.cpp -lpthread -lz -o convertxyz */
+int WriteArcade (int argc, char **argv);
+
+int main (int argc, char **argv) {
+
+	if (argc > 1 && std::string(argv[1]) == "--arcade")
+		return WriteArcade (argc, argv);
 
 	FILE * fp = fopen("xyz", "r");
 	FILE * wp = fopen ("xyz.bin", "wb");
@@ -71,3 +79,85 @@ int main () {
 	fclose(fp); fclose(wp);
 	return 0;
 }
+
+// reads the next frame of an xyz-style file - the atom count, a comment line, then a name and position on each line
+static bool ReadXYZFrame (FILE * fp, std::vector<std::string>& names, std::vector<double>& coords) {
+	unsigned int N;
+	char dump[1000];
+	char name[100];
+	if (fscanf (fp, " %u", &N) != 1) return false;
+	fgets(dump, 1000, fp);	 // clear the rest of the line of the header
+	fgets(dump, 1000, fp);	// skip the 2nd header line
+
+	names.resize(N);
+	coords.resize(3*N);
+	for (unsigned int i = 0; i < N; i++) {
+		if (fgets(dump, 1000, fp) == NULL || sscanf (dump, " %99s %lf %lf %lf", name, &coords[3*i], &coords[3*i+1], &coords[3*i+2]) != 4) return false;
+		names[i] = name;
+	}
+	return true;
+}
+
+int WriteArcade (int argc, char **argv) {
+
+	FILE * fp = fopen("xyz", "r");
+	if (fp == (FILE *)NULL) {
+		std::cout << "Couldn't open the xyz file" << std::endl;
+		return 1;
+	}
+	FILE * wan = fopen("wanniers", "r");
+
+	VecR box (0.0, 0.0, 0.0);
+	if (argc >= 5)
+		box = VecR (atof(argv[2]), atof(argv[3]), atof(argv[4]));
+
+	md_files::arcade::topology_vec topology;
+	FILE * top = fopen("xyz.top", "r");
+	if (top != (FILE *)NULL) {
+		fclose (top);
+		md_files::MolecularTopologyFile topfile ("xyz.top");
+		topology.assign (topfile.begin(), topfile.end());
+	}
+
+	std::vector<std::string> names, wannier_names;
+	std::vector<double> coords, wanniers;
+	if (!ReadXYZFrame (fp, names, coords)) {
+		std::cout << "Couldn't read the first frame of the xyz file" << std::endl;
+		return 1;
+	}
+	// the first wannier frame gives the number of centers, and is read again along with the first xyz frame
+	if (wan != (FILE *)NULL && !ReadXYZFrame (wan, wannier_names, wanniers)) {
+		fclose (wan);
+		wan = (FILE *)NULL;
+	}
+	if (wan != (FILE *)NULL)
+		rewind (wan);
+
+	std::cout << "Converting file xyz to xyz.arc - " << names.size() << " atoms";
+	if (wan != (FILE *)NULL) std::cout << ", " << wanniers.size()/3 << " wannier centers";
+	if (!topology.empty()) std::cout << ", " << topology.size() << " molecules";
+	std::cout << std::endl;
+
+	const unsigned int num_atoms = names.size();
+	const unsigned int num_wanniers = wanniers.size()/3;
+	md_files::ArcadeWriter writer ("xyz.arc", names, num_wanniers, topology);
+
+	do {
+		if (names.size() != num_atoms) {
+			std::cout << "frame " << writer.NumFrames() << " has " << names.size() << " atoms instead of the expected " << num_atoms << " atoms" << std::endl;
+			break;
+		}
+		if (num_wanniers && (!ReadXYZFrame (wan, wannier_names, wanniers) || wanniers.size() != 3*num_wanniers)) {
+			std::cout << "the wannier file ran out after " << writer.NumFrames() << " frames" << std::endl;
+			break;
+		}
+		writer.WriteFrame (&coords[0], num_wanniers ? &wanniers[0] : (const double *)NULL, box);
+	} while (ReadXYZFrame (fp, names, coords));
+
+	writer.Close();
+	std::cout << "Wrote " << writer.NumFrames() << " frames" << std::endl;
+
+	fclose(fp);
+	if (wan != (FILE *)NULL) fclose(wan);
+	return 0;
+}
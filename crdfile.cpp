@@ -6,38 +6,90 @@ namespace md_files {
 		_periodic(periodic) {
 //			ReadLine (); // skip the first frame's header
 			rewind (_file);
+			// the coordinates of each frame are followed by the box dimensions in periodic systems
+			_frame_buffer.resize(3*c_size + ((_periodic) ? 3 : 0));
+			this->_IndexFrames (0, sizeof(float) * _frame_buffer.size());
+			this->_value_bytes = sizeof(float);
+			this->_trailer_bytes = (_periodic) ? 3 * sizeof(float) : 0;
 			LoadNext ();	// load the first frame of the file
 		}
 
 
 	void CRDFile::LoadNext () {
 
-		// grab each coordinate from the file
-		float t;
-		for (std::vector<double>::iterator it = _coords.begin(); it != _coords.end(); it++) {
-			_eof = feof(_file);
-
-			fread (&t, sizeof(float), 1, _file);
-			*it = t;
+		const float * frame;
+		if (this->_Prefetching()) {
+			frame = (const float *)this->_NextFrameBuffer();
+		}
+		// only the selected atoms (and the box) are read - the others are left as they were in the buffer
+		else if (!_selection.empty()) {
+			frame = &_frame_buffer[0];
+			if (!this->_ReadFrame ((char *)&_frame_buffer[0], _frame))
+				frame = (const float *)NULL;
+		}
+		else {
+			// the whole frame - coordinates and box dimensions - is read in one go
+			frame = &_frame_buffer[0];
+			if (fread (&_frame_buffer[0], sizeof(float), _frame_buffer.size(), _file) != _frame_buffer.size())
+				frame = (const float *)NULL;
 		}
 
-		float dims[3];
-		if (_periodic) {
-			// process the next frame's header line (grab the box dimensions)
-			fread (dims, sizeof(float), 3, _file);
+		// a short read means the trajectory has run out. The last full frame is left in place
+		if (frame == (const float *)NULL) {
+			_eof = true;
+			return;
 		}
-		_dimensions[0] = dims[0];
-		_dimensions[1] = dims[1];
-		_dimensions[2] = dims[2];
 
+		this->_DecodeFrame (frame);
 		++_frame;
 
 		return;
 	}
 
+	// The frames read ahead went into the reader's ring rather than the frame buffer, so the buffer is brought up to the current frame before the unselected atoms start being left in it
+	void CRDFile::Select (const std::vector<int>& indices, const int refresh) {
+		const bool prefetching = this->_Prefetching();
+		if (!this->_SelectAtoms (indices, refresh)) return;
+		if (prefetching) {
+			for (int i = 0; i < (int)_coords.size(); i++)
+				_frame_buffer[i] = (float)_coords[i];
+			if (_periodic) {
+				for (int i = 0; i < 3; i++)
+					_frame_buffer[_coords.size() + i] = (float)_dimensions[i];
+			}
+		}
+		return;
+	}
+
+	// widens the frame's floats into the coordinate array, and picks up the box dimensions that follow them
+	void CRDFile::_DecodeFrame (const float * frame) {
+		const int n = (int)_coords.size();
+		double * coords = &_coords[0];
+
+		int i = 0;
+#ifdef __SSE2__
+		for (; i + 4 <= n; i += 4) {
+			__m128 f = _mm_loadu_ps (frame + i);
+			_mm_storeu_pd (coords + i, _mm_cvtps_pd (f));
+			_mm_storeu_pd (coords + i + 2, _mm_cvtps_pd (_mm_movehl_ps (f, f)));
+		}
+#endif
+		for (; i < n; i++)
+			coords[i] = frame[i];
+
+		if (_periodic) {
+			frame += n;
+			_dimensions[0] = frame[0];
+			_dimensions[1] = frame[1];
+			_dimensions[2] = frame[2];
+		}
+		return;
+	}
+
 	void CRDFile::Rewind () {
-		rewind(this->_file);
+		this->_PositionFile(0);
 		//ReadLine();
+		this->_frame = 0;
 		LoadNext();
 		this->_frame = 1;
 	}	// rewind
@@ -2,6 +2,9 @@
 #define CRDFILE_H_
 
 #include "mdsystem.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 // Class for parsing coordinate files from Amber molecular dynamics trajectories
 
@@ -16,12 +19,14 @@ namespace md_files {
 			// Various control functions
 			void LoadNext ();
 			void Rewind ();
-
-			const VecR& Dimensions () const { return _dimensions; }
+			// frames are fixed-size, so just the selected atoms can be read out of each
+			void Select (const std::vector<int>& indices, const int refresh = 0);
 
 		protected:
-			VecR			_dimensions;		// Dimensions of the system (box size)
 			bool			_periodic;	// are periodic boundaries being used
+
+			std::vector<float>	_frame_buffer;	// raw floats of a frame as stored in the file
+			void _DecodeFrame (const float * frame);
 	};
 
 }	// namespace md files
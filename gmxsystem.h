@@ -0,0 +1,125 @@
+#ifndef GMXSYSTEM_H_
+#define GMXSYSTEM_H_
+
+#include "mdsystem.h"
+#include "grofile.h"
+#include "trrfile.h"
+#include "xtcfile.h"
+
+namespace gromacs {
+
+	using namespace md_system;
+
+	/* A system built from a GROMACS run: the .gro file names the atoms and residues, and the trajectory (T is either a TRRFile or an XTCFile) gives the positions and box of each frame. Each residue is made into a molecule. */
+	template <class T>
+		class GMXSystem : public md_system::MDSystem {
+
+			protected:
+				GROFile		_grofile;
+				T					_coords;
+
+				void _ParseAtomInformation ();
+				void _ParseMolecules ();
+
+				Atom_ptr_vec	_atoms;		// the atoms in the system
+				Mol_ptr_vec		_mols;		// the molecules in the system
+
+			public:
+				GMXSystem (const std::string& gro, const std::string& trajectory);
+				virtual ~GMXSystem ();
+
+				void LoadNext () {
+					Molecule::NextFrame();
+					_coords.LoadNext();
+					MDSystem::Dimensions (_coords.Dimensions());		// the box can change during the run
+				}
+				void LoadFirst () { }
+				void Rewind () { this->Seek(0); }
+				void Seek (const int frame) {
+					Molecule::NextFrame();
+					_coords.Seek(frame);
+					MDSystem::Dimensions (_coords.Dimensions());
+				}
+				int NumFrames () const { return _coords.NumFrames(); }
+
+				bool eof () const { return _coords.eof(); }
+
+				const VecR&	Dimensions () const { return _coords.Dimensions(); }
+
+				Mol_ptr_vec& Molecules () { return _mols; }
+				Mol_it begin_mols () const { return _mols.begin(); }
+				Mol_it end_mols () const { return _mols.end(); }
+				MolPtr Molecules (int index) const { return _mols[index]; }
+				int NumMols () const { return _mols.size(); }
+
+				Atom_ptr_vec& Atoms () { return _atoms; }
+				Atom_it begin () const { return _atoms.begin(); }
+				Atom_it end () const { return _atoms.end(); }
+				AtomPtr Atoms (const int index) const { return _atoms[index]; }
+				AtomPtr operator[] (int index) const { return _atoms[index]; }
+				int NumAtoms ()	const { return (int)_atoms.size(); }
+
+				int size () const { return (int)_atoms.size(); }
+		};
+
+
+	template <class T>
+		GMXSystem<T>::GMXSystem (const std::string& gro, const std::string& trajectory) :
+			MDSystem (),
+			_grofile(gro),
+			_coords(trajectory)
+	{
+		if (_grofile.NumAtoms() != (int)_coords.size()) {
+			printf ("GMXSystem c-tor - the gro file %s has %d atoms, but the trajectory %s has %d\n", gro.c_str(), _grofile.NumAtoms(), trajectory.c_str(), (int)_coords.size());
+			exit(1);
+		}
+
+		_atoms = Atom_ptr_vec(_grofile.NumAtoms(), (AtomPtr)NULL);
+		MDSystem::Dimensions (_coords.Dimensions());
+
+		this->_ParseAtomInformation ();
+		this->_ParseMolecules ();
+		return;
+	}
+
+	template <class T>
+		GMXSystem<T>::~GMXSystem () {
+			for (Mol_ptr_vec::iterator it = _mols.begin(); it != _mols.end(); it++) {
+				delete *it;
+			}
+			for (Atom_ptr_vec::iterator it = _atoms.begin(); it != _atoms.end(); it++) {
+				delete *it;
+			}
+		}
+
+	// the atoms point straight into the trajectory's coordinates, so they follow along as frames are loaded
+	template <class T>
+		void GMXSystem<T>::_ParseAtomInformation () {
+			for (int i = 0; i < _grofile.NumAtoms(); i++) {
+				_atoms[i] = new Atom(_grofile.AtomNames()[i], _coords(i));
+				_atoms[i]->ID(i);
+			}
+			return;
+		}
+
+	template <class T>
+		void GMXSystem<T>::_ParseMolecules () {
+
+			for (int mol = 0; mol < _grofile.NumMols(); mol++) {
+				std::string name = _grofile.MolNames()[mol];
+				MolPtr newmol = md_system::MoleculeFactory(name);
+				newmol->Name(name);
+				newmol->MolID(mol);
+
+				int molpointer = _grofile.MolPointers()[mol];
+				for (int atom = 0; atom < _grofile.MolSizes()[mol]; atom++) {
+					newmol->AddAtom (_atoms[molpointer + atom]);
+				}
+
+				_mols.push_back(newmol);
+			}
+			return;
+		}
+
+}	// namespace gromacs
+#endif
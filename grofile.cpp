@@ -0,0 +1,58 @@
+#include "grofile.h"
+
+namespace gromacs {
+
+	// strips the padding off a fixed-width field
+	static std::string trim (const std::string& field) {
+		size_t first = field.find_first_not_of(" \t");
+		if (first == std::string::npos) return std::string("");
+		size_t last = field.find_last_not_of(" \t\r\n");
+		return field.substr(first, last-first+1);
+	}
+
+	GROFile::GROFile (const std::string path) {
+
+		FILE * grofile = fopen (path.c_str(), "r");
+		if (grofile == (FILE *)NULL) {
+			std::cout << "Error opening the gro file " << path << std::endl;
+			exit(1);
+		}
+
+		char line[1000];
+		int num_atoms;
+		// the title line, and then the number of atoms
+		if (fgets (line, 1000, grofile) == NULL || fgets (line, 1000, grofile) == NULL || sscanf (line, " %d", &num_atoms) != 1) {
+			std::cout << "Couldn't read the header of the gro file " << path << std::endl;
+			exit(1);
+		}
+
+		// each atom line has the fixed columns: residue number (5), residue name (5), atom name (5), atom number (5), and then the position
+		int last_resnum = -1;
+		std::string last_resname;
+		for (int i = 0; i < num_atoms; i++) {
+			if (fgets (line, 1000, grofile) == NULL) {
+				std::cout << "The gro file " << path << " ended after " << i << " of " << num_atoms << " atoms" << std::endl;
+				exit(1);
+			}
+			std::string atomline (line);
+			if (atomline.size() < 20) atomline.resize(20, ' ');
+
+			int resnum = atoi (atomline.substr(0,5).c_str());
+			std::string resname = trim (atomline.substr(5,5));
+			_atomnames.push_back (trim (atomline.substr(10,5)));
+
+			if (i == 0 || resnum != last_resnum || resname != last_resname) {
+				_molnames.push_back (resname);
+				_molpointers.push_back (i);
+				_molsizes.push_back (0);
+				last_resnum = resnum;
+				last_resname = resname;
+			}
+			++_molsizes.back();
+		}
+
+		fclose (grofile);
+		return;
+	}
+
+}	// namespace gromacs
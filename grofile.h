@@ -0,0 +1,36 @@
+#ifndef GROFILE_H_
+#define GROFILE_H_
+
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <iostream>
+
+namespace gromacs {
+
+	/* A GROMACS .gro structure file. Only the atom and residue names are used - they play the part of the topology for a GROMACS trajectory. Each residue (a run of atoms with the same residue number and name) is taken as a molecule. */
+	class GROFile {
+
+		protected:
+
+			std::vector<std::string> _atomnames;
+			std::vector<std::string> _molnames;		// residue name of each molecule
+			std::vector<int>	_molpointers;		// index of the first atom of each molecule (counting from 0)
+			std::vector<int>	_molsizes;			// the number of atoms in each molecule
+
+		public:
+
+			GROFile (const std::string path);
+
+			std::vector<std::string>& AtomNames () { return _atomnames; }
+			std::vector<std::string>& MolNames () { return _molnames; }
+			std::vector<int>& MolPointers () { return _molpointers; }
+			std::vector<int>& MolSizes ()	{ return _molsizes; }
+
+			int NumAtoms () const { return (int)_atomnames.size(); }
+			int NumMols () const { return (int)_molnames.size(); }
+	};
+
+}	// namespace gromacs
+#endif
@@ -0,0 +1,357 @@
+#include "gzipfile.h"
+
+namespace md_files {
+
+	// size of the inflated chunks handed to the reader, the number of them kept ahead, and the size of the compressed reads
+	static const size_t CHUNK_BYTES = 1 << 18;
+	static const int RING_CHUNKS = 4;
+	static const size_t INPUT_BYTES = 1 << 16;
+
+	// the fopencookie functions for the stream
+	static ssize_t gzip_read (void * cookie, char * buffer, size_t bytes) {
+		return static_cast<GzipFile *>(cookie)->Read (buffer, bytes);
+	}
+
+	static int gzip_seek (void * cookie, off64_t * offset, int whence) {
+		return static_cast<GzipFile *>(cookie)->Seek (offset, whence);
+	}
+
+	static int gzip_close (void * cookie) {
+		delete static_cast<GzipFile *>(cookie);
+		return 0;
+	}
+
+	static inline unsigned int to_uint16 (const unsigned char * bytes) { return bytes[0] | (bytes[1] << 8); }
+	static inline unsigned int to_uint32 (const unsigned char * bytes) { return to_uint16(bytes) | (to_uint16(bytes+2) << 16); }
+	static inline long long to_uint64 (const unsigned char * bytes) { return (long long)to_uint32(bytes) | ((long long)to_uint32(bytes+4) << 32); }
+
+
+	bool GzipFile::IsGzip (const std::string& path) {
+		unsigned char magic[2] = { 0, 0 };
+		FILE * file = fopen (path.c_str(), "rb");
+		if (file == (FILE *)NULL) return false;
+		size_t bytes = fread (magic, 1, 2, file);
+		fclose (file);
+		return bytes == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+	}
+
+	// zlib reads files that aren't compressed as they are
+	size_t GzipFile::Peek (const std::string& path, char * buffer, const size_t bytes) {
+		gzFile file = gzopen (path.c_str(), "rb");
+		if (file == (gzFile)NULL) return 0;
+		int read = gzread (file, buffer, (unsigned int)bytes);
+		gzclose (file);
+		return (read > 0) ? (size_t)read : 0;
+	}
+
+	FILE * GzipFile::Open (const std::string& path, GzipFile ** gzip) {
+		int fd = open (path.c_str(), O_RDONLY);
+		if (fd < 0) return (FILE *)NULL;
+
+		GzipFile * file = new GzipFile (path, fd);
+		cookie_io_functions_t functions = { gzip_read, NULL, gzip_seek, gzip_close };
+		FILE * stream = fopencookie (file, "rb", functions);
+		if (stream == (FILE *)NULL) {
+			delete file;
+			return (FILE *)NULL;
+		}
+
+		if (gzip != (GzipFile **)NULL)
+			*gzip = file;
+		return stream;
+	}
+
+	GzipFile::GzipFile (const std::string& path, const int fd) :
+		_path(path), _fd(fd),
+		_compressed_size(0), _size(-1),
+		_position(0),
+		_ring(RING_CHUNKS),
+		_head(0), _tail(0), _filled(0),
+		_held(false), _inflater_done(false), _stop_inflater(false), _running(false) {
+
+			struct stat64 st;
+			if (!fstat64 (_fd, &st))
+				_compressed_size = st.st_size;
+
+			for (std::vector<chunk_t>::iterator it = _ring.begin(); it != _ring.end(); it++)
+				it->data.resize(CHUNK_BYTES);
+			pthread_mutex_init (&_ring_lock, NULL);
+			pthread_cond_init (&_chunk_ready, NULL);
+			pthread_cond_init (&_slot_free, NULL);
+
+			// a plain gzip file can only be started from the top
+			if (!this->_ReadGZI() && !this->_IndexBlocks()) {
+				_blocks.clear();
+				block_t start = { 0, 0 };
+				_blocks.push_back (start);
+				_size = -1;
+			}
+		}
+
+	GzipFile::~GzipFile () {
+		this->_StopInflater();
+		close (_fd);
+		pthread_mutex_destroy (&_ring_lock);
+		pthread_cond_destroy (&_chunk_ready);
+		pthread_cond_destroy (&_slot_free);
+	}
+
+	/* bgzip writes the compressed size of each block into the gzip header (the 'BC' extra field), and the uncompressed size is the last 4 bytes of the block. So the blocks can be listed by hopping from header to header, without inflating anything. Indexing starts from the last block already listed (e.g. from the .gzi file) or from the top of the file */
+	bool GzipFile::_IndexBlocks () {
+		block_t block = { 0, 0 };
+		if (!_blocks.empty()) {
+			block = _blocks.back();
+			_blocks.pop_back();
+		}
+
+		unsigned char header[18];
+		std::vector<unsigned char> extra;
+		while (block.compressed < _compressed_size) {
+			if (pread64 (_fd, header, 12, block.compressed) != 12 || header[0] != 0x1f || header[1] != 0x8b || !(header[3] & 0x04))
+				return false;
+
+			// look through the extra subfields for the block size
+			unsigned int extra_bytes = to_uint16 (header + 10);
+			extra.resize(extra_bytes);
+			if (pread64 (_fd, &extra[0], extra_bytes, block.compressed + 12) != (ssize_t)extra_bytes)
+				return false;
+			long long block_bytes = 0;
+			for (unsigned int i = 0; i + 4 <= extra_bytes; i += 4 + to_uint16(&extra[i+2])) {
+				if (extra[i] == 'B' && extra[i+1] == 'C' && to_uint16(&extra[i+2]) == 2)
+					block_bytes = to_uint16(&extra[i+4]) + 1;
+			}
+			if (!block_bytes) return false;
+
+			if (pread64 (_fd, header, 4, block.compressed + block_bytes - 4) != 4)
+				return false;
+			_blocks.push_back (block);
+			block.compressed += block_bytes;
+			block.uncompressed += to_uint32 (header);
+		}
+
+		_size = block.uncompressed;
+		return !_blocks.empty();
+	}
+
+	// bgzip -i (or -r) writes the location of every block after the first to a .gzi file alongside the data
+	bool GzipFile::_ReadGZI () {
+		std::string index_path = _path + ".gzi";
+		FILE * index = fopen (index_path.c_str(), "rb");
+		if (index == (FILE *)NULL) return false;
+
+		unsigned char bytes[16];
+		bool read = (fread (bytes, 1, 8, index) == 8);
+		long long entries = read ? to_uint64 (bytes) : 0;
+
+		block_t block = { 0, 0 };
+		_blocks.push_back (block);
+		for (long long i = 0; read && i < entries; i++) {
+			read = (fread (bytes, 1, 16, index) == 16);
+			block.compressed = to_uint64 (bytes);
+			block.uncompressed = to_uint64 (bytes + 8);
+			if (read) _blocks.push_back (block);
+		}
+		fclose (index);
+
+		// the blocks after the last one listed fill in the total size
+		if (!read || !this->_IndexBlocks()) {
+			printf ("GzipFile - the index %s doesn't match %s - indexing the blocks from the file itself\n", index_path.c_str(), _path.c_str());
+			_blocks.clear();
+			return false;
+		}
+		return true;
+	}
+
+	int GzipFile::_BlockOf (const long long position) const {
+		int low = 0, high = (int)_blocks.size() - 1;
+		while (low < high) {
+			int mid = (low + high + 1) / 2;
+			if (_blocks[mid].uncompressed <= position) low = mid;
+			else high = mid - 1;
+		}
+		return low;
+	}
+
+	ssize_t GzipFile::Read (char * buffer, size_t bytes) {
+		// start inflating from the last block at or before the current position
+		if (!_running)
+			this->_StartInflater (_blocks[this->_BlockOf(_position)]);
+
+		size_t copied = 0;
+		while (copied < bytes) {
+			chunk_t * chunk = this->_CurrentChunk();
+			if (chunk == (chunk_t *)NULL) break;
+
+			// skip over what comes before the position (after a seek into the middle of a block)
+			long long chunk_end = chunk->start + (long long)chunk->length;
+			if (_position >= chunk_end) {
+				this->_ReleaseChunk();
+				continue;
+			}
+
+			size_t offset = (size_t)(_position - chunk->start);
+			size_t count = std::min(bytes - copied, (size_t)(chunk_end - _position));
+			memcpy (buffer + copied, &chunk->data[offset], count);
+			copied += count;
+			_position += count;
+		}
+		return (ssize_t)copied;
+	}
+
+	int GzipFile::Seek (off64_t * offset, int whence) {
+		long long target = *offset;
+		if (whence == SEEK_CUR)
+			target += _position;
+		else if (whence == SEEK_END) {
+			if (_size < 0) return -1;
+			target += _size;
+		}
+		if (target < 0) return -1;
+
+		// keep on with the running inflater if the target is ahead of it, and there's no block to start from in between
+		if (_running && !(target >= _position && _blocks[this->_BlockOf(target)].uncompressed <= _position))
+			this->_StopInflater();
+
+		_position = target;
+		*offset = target;
+		return 0;
+	}
+
+	// pthread-compatible function for running the inflater thread
+	void * inflate_ahead (void * file) {
+		static_cast<GzipFile *>(file)->_Inflate();
+		pthread_exit(NULL);
+	}
+
+	void GzipFile::_StartInflater (const block_t& start) {
+		_start = start;
+		_head = _tail = _filled = 0;
+		_held = false;
+		_inflater_done = false;
+		_stop_inflater = false;
+
+		int rc = pthread_create (&_inflater, NULL, inflate_ahead, (void *)this);
+		if (rc) {
+			printf ("GzipFile - couldn't start the inflater thread for %s\n", _path.c_str());
+			exit(1);
+		}
+		_running = true;
+		return;
+	}
+
+	void GzipFile::_StopInflater () {
+		if (!_running) return;
+
+		pthread_mutex_lock (&_ring_lock);
+		_stop_inflater = true;
+		pthread_cond_signal (&_slot_free);
+		pthread_mutex_unlock (&_ring_lock);
+		pthread_join (_inflater, NULL);
+
+		_running = false;
+		return;
+	}
+
+	// inflates the file from the starting block on, a chunk at a time, until the end of the file (or until told to stop)
+	void GzipFile::_Inflate () {
+		const int slots = (int)_ring.size();
+
+		z_stream stream;
+		memset (&stream, 0, sizeof(stream));
+		inflateInit2 (&stream, 15 + 16);		// gzip headers
+
+		std::vector<unsigned char> input (INPUT_BYTES);
+		long long compressed = _start.compressed;
+		long long uncompressed = _start.uncompressed;
+		bool end = false, in_member = false;
+
+		while (!end) {
+			pthread_mutex_lock (&_ring_lock);
+			while (_filled + (_held ? 1 : 0) >= slots && !_stop_inflater)
+				pthread_cond_wait (&_slot_free, &_ring_lock);
+			bool stop = _stop_inflater;
+			int slot = _tail;
+			pthread_mutex_unlock (&_ring_lock);
+			if (stop) break;
+
+			chunk_t& chunk = _ring[slot];
+			stream.next_out = (Bytef *)&chunk.data[0];
+			stream.avail_out = (uInt)chunk.data.size();
+
+			while (stream.avail_out && !end) {
+				if (!stream.avail_in) {
+					ssize_t bytes = pread64 (_fd, &input[0], input.size(), compressed);
+					if (bytes <= 0) {
+						if (in_member)
+							printf ("GzipFile - %s ends partway through the compressed data\n", _path.c_str());
+						end = true;
+						break;
+					}
+					compressed += bytes;
+					stream.next_in = &input[0];
+					stream.avail_in = (uInt)bytes;
+				}
+
+				int rc = inflate (&stream, Z_NO_FLUSH);
+				in_member = true;
+				if (rc == Z_STREAM_END) {
+					// concatenated files, and every bgzip block, start a new gzip member
+					in_member = false;
+					if (!stream.avail_in && compressed >= _compressed_size)
+						end = true;
+					else
+						inflateReset (&stream);
+				}
+				else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+					printf ("GzipFile - the compressed data of %s is corrupt (zlib error %d: %s)\n", _path.c_str(), rc, stream.msg ? stream.msg : "");
+					exit(1);
+				}
+			}
+
+			chunk.start = uncompressed;
+			chunk.length = chunk.data.size() - stream.avail_out;
+			uncompressed += chunk.length;
+			if (!chunk.length) continue;
+
+			pthread_mutex_lock (&_ring_lock);
+			_tail = (_tail + 1) % slots;
+			++_filled;
+			pthread_cond_signal (&_chunk_ready);
+			pthread_mutex_unlock (&_ring_lock);
+		}
+		inflateEnd (&stream);
+
+		pthread_mutex_lock (&_ring_lock);
+		_inflater_done = true;
+		pthread_cond_signal (&_chunk_ready);
+		pthread_mutex_unlock (&_ring_lock);
+		return;
+	}
+
+	GzipFile::chunk_t * GzipFile::_CurrentChunk () {
+		pthread_mutex_lock (&_ring_lock);
+		while (!_held && !_filled && !_inflater_done)
+			pthread_cond_wait (&_chunk_ready, &_ring_lock);
+
+		chunk_t * chunk = (chunk_t *)NULL;
+		if (!_held && _filled) {
+			--_filled;
+			_held = true;
+		}
+		if (_held)
+			chunk = &_ring[_head];
+		pthread_mutex_unlock (&_ring_lock);
+		return chunk;
+	}
+
+	// hands the held chunk back to the inflater
+	void GzipFile::_ReleaseChunk () {
+		pthread_mutex_lock (&_ring_lock);
+		_head = (_head + 1) % (int)_ring.size();
+		_held = false;
+		pthread_cond_signal (&_slot_free);
+		pthread_mutex_unlock (&_ring_lock);
+		return;
+	}
+
+}	// namespace md_files
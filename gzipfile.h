@@ -0,0 +1,92 @@
+#ifndef GZIPFILE_H_
+#define GZIPFILE_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+// Reading gzip-compressed trajectories without decompressing them to disk first
+
+namespace md_files {
+
+	/* A gzip file opened as an ordinary FILE stream (through fopencookie), so the trajectory readers can fread and fseek it as they would the uncompressed file. The data is inflated by a background thread a chunk at a time into a small ring, which the reads drain.
+
+		 Files written with bgzip are made up of independent blocks of up to 64kB, and the uncompressed location of each block is known (from the .gzi index when there is one, or from a pass over the block headers). Seeking starts the inflater at the block holding the target, so any frame can be reached directly, and the size of the uncompressed data - and so the number of frames - is known up front. Ordinary gzip files can only be inflated from the start: they're read straight through, seeking forward skips through the data, and seeking backward starts over. */
+	class GzipFile {
+
+		public:
+			// checks for the gzip magic number
+			static bool IsGzip (const std::string& path);
+			// reads the first bytes of the (uncompressed) data, so a file's format can be checked whether or not it's compressed. Returns the number of bytes read
+			static size_t Peek (const std::string& path, char * buffer, const size_t bytes);
+			// opens the file as a stream of the uncompressed data. The GzipFile is owned by the stream, and is freed by fclose
+			static FILE * Open (const std::string& path, GzipFile ** gzip = (GzipFile **)NULL);
+
+			// the number of uncompressed bytes - -1 if that can't be known without inflating the whole file
+			long long Size () const { return _size; }
+			bool Seekable () const { return _blocks.size() > 1; }
+
+			// the fopencookie functions
+			ssize_t Read (char * buffer, size_t bytes);
+			int Seek (off64_t * offset, int whence);
+			~GzipFile ();
+
+		protected:
+			GzipFile (const std::string& path, const int fd);
+
+			std::string		_path;
+			int						_fd;
+			long long			_compressed_size;
+			long long			_size;
+
+			// places the inflater can start from: the start of each bgzip block, or just the start of the file
+			struct block_t {
+				long long	compressed;
+				long long	uncompressed;
+			};
+			std::vector<block_t>	_blocks;
+			bool _IndexBlocks ();
+			bool _ReadGZI ();
+			// the last block starting at or before the given uncompressed offset
+			int _BlockOf (const long long position) const;
+
+			long long			_position;			// uncompressed offset of the next byte to be read
+
+			/* The inflated chunks are handed over through a single-producer/single-consumer ring, as in CoordinateFile's read-ahead. The chunk at the head is held while it's being read out of. */
+			struct chunk_t {
+				std::vector<char>	data;
+				long long					start;			// uncompressed offset of the first byte
+				size_t						length;
+			};
+			std::vector<chunk_t>	_ring;
+			int						_head, _tail, _filled;
+			bool					_held;
+			bool					_inflater_done;
+			bool					_stop_inflater;
+			bool					_running;
+			block_t				_start;				// where the inflater started
+			pthread_t			_inflater;
+			pthread_mutex_t	_ring_lock;
+			pthread_cond_t	_chunk_ready;
+			pthread_cond_t	_slot_free;
+
+			void _StartInflater (const block_t& start);
+			void _StopInflater ();
+			void _Inflate ();
+			friend void * inflate_ahead (void * file);
+
+			// the held chunk, waiting on the inflater if need be. NULL at the end of the data
+			chunk_t * _CurrentChunk ();
+			void _ReleaseChunk ();
+	};
+
+}	// namespace md_files
+#endif
@@ -15,6 +15,7 @@ namespace md_system {
 	}
 
 	void Proton::SetAtoms () {
+		if (this->_Current (_atoms_frame)) return;
 		_h = this->GetAtom("H");
 		return;
 	}
@@ -26,5 +27,5 @@ namespace md_system {
 	Chlorine::Chlorine () : Molecule() { this->Rename("Cl-"); _moltype = Molecule::CL; ++numChlorines; }
 	Chlorine::Chlorine (const Molecule& molecule) : Molecule(molecule) { }
 	Chlorine::~Chlorine () { --numChlorines; }
-	void Chlorine::SetAtoms () { _cl = this->GetAtom(Atom::Cl); }
+	void Chlorine::SetAtoms () { if (this->_Current (_atoms_frame)) return; _cl = this->GetAtom(Atom::Cl); }
 }
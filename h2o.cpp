@@ -37,6 +37,7 @@ namespace md_system {
 	}
 
 	void Water::SetAtoms () {
+		if (this->_Current (_atoms_frame)) return;
 
 		// first let's grab pointers to the three atoms and give them reasonable names
 		this->_h1 = (AtomPtr)NULL; this->_h2 = (AtomPtr)NULL;
@@ -78,6 +79,7 @@ namespace md_system {
 
 		_h1->Position(axis, center - distance1);
 		_h2->Position(axis, center - distance2);
+		this->Invalidate();
 
 		return;
 	}
@@ -97,6 +99,7 @@ namespace md_system {
 	 * x-axis = y % z
 	 */
 	void Water::SetOrderAxes () {
+		if (this->_Current (_axes_frame)) return;
 
 		this->SetAtoms ();
 
@@ -108,6 +111,7 @@ namespace md_system {
 
 		// and the x-axis is easy
 		_x = (_y % _z).normalized();
+		this->_AxesChanged (true);
 
 		return;
 	}
@@ -16,6 +16,7 @@ namespace md_system {
 	}
 
 	void Hydronium::SetAtoms () {
+		if (this->_Current (_atoms_frame)) return;
 
 		// here's the hydrogen and nitrogen atoms
 		_o = this->GetAtom(Atom::O);
@@ -1,4 +1,14 @@
 #include "mdsystem.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+
+// The batched distance kernels are built for AVX2 and AVX-512 alongside the plain version, and the one to use is picked at run time. That takes function-level target attributes and __builtin_cpu_supports - other compilers get the plain loop, which they're left to vectorize for whatever they're targeting.
+#if defined(__x86_64__) && (defined(__clang__) || (defined(__GNUC__) && !defined(__INTEL_COMPILER) && __GNUC__ >= 5))
+#define DISTANCE_DISPATCH
+#include <immintrin.h>
+#endif
 
 namespace md_system {
 
@@ -6,41 +16,294 @@ namespace md_system {
 	CoordinateFile::CoordinateFile (const std::string path, int const c_size) :
 		_file ((FILE *)NULL),
 		_path(path),
+		_gzip ((md_files::GzipFile *)NULL),
 		_size(c_size),
 		_coords (_size*3, 0.0),
+		_dimensions(VecR::Zero()),
 		_frame(0),
-		_eof(true) {
-
-			_file = fopen64 (path.c_str(), "rb");
-			if (_file == (FILE *)NULL) {
-				printf ("Couldn't load the Coordinate file %s\n", path.c_str());
-				exit(1);
-			}
-			_eof = false;
+		_eof(true),
+		_header_bytes(0), _frame_bytes(0), _num_frames(-1),
+		_refresh(0), _full_frame(true), _value_bytes(sizeof(double)), _trailer_bytes(0),
+		_prefetch(false) {
 
+			this->_OpenFile (path);
 		}
 
 
 	CoordinateFile::CoordinateFile (const std::string path) :
 		_file ((FILE *)NULL),
 		_path(path),
+		_gzip ((md_files::GzipFile *)NULL),
+		_dimensions(VecR::Zero()),
 		_frame(0),
-		_eof(true) {
+		_eof(true),
+		_header_bytes(0), _frame_bytes(0), _num_frames(-1),
+		_refresh(0), _full_frame(true), _value_bytes(sizeof(double)), _trailer_bytes(0),
+		_prefetch(false) {
 
-			_file = fopen64 (path.c_str(), "rb");
-			if (_file == (FILE *)NULL)
-			{
-				printf ("Couldn't load the Coordinate file %s\n", path.c_str());
-				exit(1);
-			}
-			_eof = false;
+			this->_OpenFile (path);
 		}
 
 	CoordinateFile::CoordinateFile () :
 		_file ((FILE *)NULL),
+		_gzip ((md_files::GzipFile *)NULL),
+		_dimensions(VecR::Zero()),
 		_frame(0),
-		_eof(true) { }
+		_eof(true),
+		_header_bytes(0), _frame_bytes(0), _num_frames(-1),
+		_refresh(0), _full_frame(true), _value_bytes(sizeof(double)), _trailer_bytes(0),
+		_prefetch(false) { }
+
+
+	void CoordinateFile::_OpenFile (const std::string& path) {
+		if (md_files::GzipFile::IsGzip (path))
+			_file = md_files::GzipFile::Open (path, &_gzip);
+		else
+			_file = fopen64 (path.c_str(), "rb");
+
+		if (_file == (FILE *)NULL) {
+			printf ("Couldn't load the Coordinate file %s\n", path.c_str());
+			exit(1);
+		}
+		_eof = false;
+		return;
+	}
+
+	long long CoordinateFile::_FileSize () const {
+		if (_gzip != (md_files::GzipFile *)NULL)
+			return _gzip->Size();
+
+		struct stat64 st;
+		if (_file == (FILE *)NULL || fstat64 (fileno(_file), &st)) return -1;
+		return st.st_size;
+	}
+
+	// a compressed file that isn't split into blocks (i.e. not written by bgzip) has no known size, and so no index - it can still be read through from front to back
+	void CoordinateFile::_IndexFrames (const long long header_bytes, const long long frame_bytes) {
+		_header_bytes = header_bytes;
+		_frame_bytes = frame_bytes;
+		_num_frames = -1;
+
+		long long size = this->_FileSize();
+		if (_file == (FILE *)NULL || _frame_bytes <= 0 || size < 0) return;
+		_num_frames = (size > _header_bytes) ? (int)((size - _header_bytes) / _frame_bytes) : 0;
+		return;
+	}
+
+	void CoordinateFile::_IndexFrames (const std::vector<long long>& offsets) {
+		_frame_offsets = offsets;
+		_header_bytes = (offsets.empty()) ? 0 : offsets.front();
+		_frame_bytes = 0;
+		_num_frames = (int)offsets.size();
+		return;
+	}
+
+	// Without an index (a plain gzip file) the only frame that can be found is the first one, right after the header - rewinding is still allowed
+	void CoordinateFile::Seek (const int frame) {
+		if (_num_frames < 0 && frame != 0) {
+			printf ("CoordinateFile::Seek() - the file %s has no frame index to seek with\n", _path.c_str());
+			exit(1);
+		}
+		if (frame < 0 || (_num_frames >= 0 && frame >= _num_frames)) {
+			printf ("CoordinateFile::Seek() - frame %d is out of range. The file %s has %d frames\n", frame, _path.c_str(), _num_frames);
+			exit(1);
+		}
+
+		this->_PositionFile ((_num_frames < 0) ? _header_bytes : this->_FrameOffset(frame));
+		_eof = false;
+		_frame = frame;
+		this->LoadNext();
+		_frame = frame+1;
+		return;
+	}
 
+	void CoordinateFile::_PositionFile (const long long offset) {
+		bool prefetching = _prefetch;
+		this->_StopPrefetch();
+		fseeko64 (_file, offset, SEEK_SET);
+		if (prefetching)
+			this->_StartPrefetch();
+		return;
+	}
+
+	void CoordinateFile::Select (const std::vector<int>& indices, const int) {
+		if (!indices.empty())
+			printf ("CoordinateFile::Select() - the frames of %s can only be read whole, so all the atoms are loaded\n", _path.c_str());
+		return;
+	}
+
+	bool CoordinateFile::_SelectAtoms (const std::vector<int>& indices, const int refresh) {
+		if (!indices.empty() && (_gzip != (md_files::GzipFile *)NULL || _frame_bytes <= 0 || _num_frames < 0)) {
+			printf ("CoordinateFile::Select() - %s can't be read a piece of a frame at a time (compressed files have to be inflated in full), so all the atoms are loaded\n", _path.c_str());
+			return false;
+		}
+		this->_StopPrefetch();
+
+		bool was_selecting = !_selection.empty();
+		_selection = indices;
+		std::sort (_selection.begin(), _selection.end());
+		_selection.erase (std::unique (_selection.begin(), _selection.end()), _selection.end());
+		if (!_selection.empty() && (_selection.front() < 0 || _selection.back() >= (int)_size)) {
+			printf ("CoordinateFile::Select() - atom %d is out of range. The file %s has %d atoms\n", (_selection.front() < 0) ? _selection.front() : _selection.back(), _path.c_str(), (int)_size);
+			exit(1);
+		}
+		_refresh = refresh;
+
+		// Atoms less than a page apart are merged into one run - the page between them gets read either way, so it's cheaper to read through the gap than to make another call
+		const size_t atom_bytes = 3 * _value_bytes;
+		const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+		_runs.clear();
+		for (std::vector<int>::const_iterator it = _selection.begin(); it != _selection.end(); it++) {
+			size_t offset = (size_t)(*it) * atom_bytes;
+			if (!_runs.empty() && _runs.back().offset + _runs.back().bytes + page > offset)
+				_runs.back().bytes = offset + atom_bytes - _runs.back().offset;
+			else {
+				run_t run = { offset, atom_bytes };
+				_runs.push_back (run);
+			}
+		}
+		if (!_selection.empty() && _trailer_bytes) {
+			run_t run = { (size_t)_frame_bytes - _trailer_bytes, _trailer_bytes };
+			if (_runs.back().offset + _runs.back().bytes + page > run.offset)
+				_runs.back().bytes = run.offset + run.bytes - _runs.back().offset;
+			else
+				_runs.push_back (run);
+		}
+
+		// the selective reads don't move the file, so it's put back at the next frame for reading everything again
+		if (was_selecting && _selection.empty())
+			this->_PositionFile (this->_FrameOffset(_frame));
+		return true;
+	}
+
+	bool CoordinateFile::_ReadFrame (char * buffer, const int frame) {
+		if (frame >= _num_frames) return false;
+		const long long start = this->_FrameOffset(frame);
+		const int fd = fileno(_file);
+
+		_full_frame = this->_RefreshFrame(frame);
+		if (_full_frame)
+			return pread64 (fd, buffer, _frame_bytes, start) == (ssize_t)_frame_bytes;
+
+		for (std::vector<run_t>::const_iterator it = _runs.begin(); it != _runs.end(); it++) {
+			if (pread64 (fd, buffer + it->offset, it->bytes, start + it->offset) != (ssize_t)it->bytes)
+				return false;
+		}
+		return true;
+	}
+
+	// pthread-compatible function for running a file's reader thread
+	void * read_ahead (void * file) {
+		static_cast<CoordinateFile *>(file)->_ReadAhead();
+		pthread_exit(NULL);
+	}
+
+	// Once the reader is running it's left to it - restarting it would pick up wherever its file position had got to, and skip the frames already read into the ring
+	void CoordinateFile::Prefetch (const int depth) {
+		if (_prefetch || depth < 1) return;
+
+		if (_frame_bytes <= 0) {
+			printf ("CoordinateFile::Prefetch() - the frames of %s aren't all the same size, so they can't be read ahead\n", _path.c_str());
+			exit(1);
+		}
+
+		if (_ring.empty()) {
+			pthread_mutex_init (&_ring_lock, NULL);
+			pthread_cond_init (&_frame_ready, NULL);
+			pthread_cond_init (&_slot_free, NULL);
+		}
+
+		// one more slot than the read-ahead depth for the frame being worked on
+		_ring.resize(depth+1);
+		for (std::vector< std::vector<char> >::iterator it = _ring.begin(); it != _ring.end(); it++)
+			it->resize(_frame_bytes);
+
+		this->_StartPrefetch();
+		return;
+	}
+
+	void CoordinateFile::_StartPrefetch () {
+		_head = _tail = _filled = 0;
+		_held = false;
+		_reader_done = false;
+		_stop_reader = false;
+
+		int rc = pthread_create(&_reader, NULL, read_ahead, (void *)this);
+		if (rc) {
+			printf ("CoordinateFile::Prefetch() - couldn't start the reader thread for %s\n", _path.c_str());
+			exit(1);
+		}
+		_prefetch = true;
+		return;
+	}
+
+	void CoordinateFile::_StopPrefetch () {
+		if (!_prefetch) return;
+
+		pthread_mutex_lock (&_ring_lock);
+		_stop_reader = true;
+		pthread_cond_signal (&_slot_free);
+		pthread_mutex_unlock (&_ring_lock);
+		pthread_join (_reader, NULL);
+
+		_prefetch = false;
+		return;
+	}
+
+	void CoordinateFile::_ReadAhead () {
+		const int slots = (int)_ring.size();
+
+		while (true) {
+			// wait for a slot that isn't waiting to be read or held as the current frame
+			pthread_mutex_lock (&_ring_lock);
+			while (_filled + (_held ? 1 : 0) >= slots && !_stop_reader)
+				pthread_cond_wait (&_slot_free, &_ring_lock);
+			bool stop = _stop_reader;
+			int slot = _tail;
+			pthread_mutex_unlock (&_ring_lock);
+			if (stop) break;
+
+			// the slot is free, so it can be filled without holding the lock
+			if (fread (&_ring[slot][0], 1, _frame_bytes, _file) != (size_t)_frame_bytes)
+				break;
+
+			pthread_mutex_lock (&_ring_lock);
+			_tail = (_tail + 1) % slots;
+			++_filled;
+			pthread_cond_signal (&_frame_ready);
+			pthread_mutex_unlock (&_ring_lock);
+		}
+
+		pthread_mutex_lock (&_ring_lock);
+		_reader_done = true;
+		pthread_cond_signal (&_frame_ready);
+		pthread_mutex_unlock (&_ring_lock);
+		return;
+	}
+
+	char * CoordinateFile::_NextFrameBuffer () {
+		const int slots = (int)_ring.size();
+
+		pthread_mutex_lock (&_ring_lock);
+		// hand the current frame's slot back to the reader
+		if (_held) {
+			_head = (_head + 1) % slots;
+			_held = false;
+			pthread_cond_signal (&_slot_free);
+		}
+
+		while (!_filled && !_reader_done)
+			pthread_cond_wait (&_frame_ready, &_ring_lock);
+
+		char * buffer = (char *)NULL;
+		if (_filled) {
+			--_filled;
+			_held = true;
+			buffer = &_ring[_head][0];
+		}
+		pthread_mutex_unlock (&_ring_lock);
+		return buffer;
+	}
 
 	// The system size for periodic boundary calculations
 	VecR MDSystem::_dimensions = VecR ();
@@ -49,6 +312,32 @@ namespace md_system {
 		return;
 	}
 
+	// The store is laid out again whenever the system's atoms are no longer the ones it was laid out for
+	const AtomStore& MDSystem::Store () {
+		const Atom_ptr_vec& atoms = this->Atoms();
+		if (_store.size() != (int)atoms.size() || (!atoms.empty() && (_store.Atoms(0) != atoms.front() || _store.Atoms(_store.size()-1) != atoms.back())))
+			_store.Assign (atoms);
+		else
+			_store.Update ();
+		return _store;
+	}
+
+	std::vector<int> MDSystem::SlabAtoms (const Mol_ptr_vec& mols, const int axis, const double low, const double high) {
+		std::vector<int> atoms;
+		for (Mol_it mol = mols.begin(); mol != mols.end(); mol++) {
+			Atom_it it = (*mol)->begin();
+			for (; it != (*mol)->end(); it++) {
+				double pos = (*it)->Position()[axis];
+				if (pos >= low && pos <= high) break;
+			}
+			if (it == (*mol)->end()) continue;
+
+			for (it = (*mol)->begin(); it != (*mol)->end(); it++)
+				atoms.push_back ((*it)->ID());
+		}
+		return atoms;
+	}
+
 	// Find the smallest vector between two locations in a periodic system defined by the dimensions.
 	// The resulting vector will point from the v1 to v2
 	VecR MDSystem::Distance (const VecR& v1, const VecR& v2) {
@@ -87,21 +376,259 @@ namespace md_system {
 		return MDSystem::Distance(atom1->Position(), atom2->Position());
 	}
 
+	// only the shortest of the pair distances is kept, and the one square root is taken at the end
 	double MDSystem::Distance (const MolPtr mol1, const MolPtr mol2) {
 
-		std::vector <double> distances;
+		double min = -1.0;
 		for (Atom_it ai = mol1->begin(); ai != mol1->end(); ai++) {
 			for (Atom_it aj = mol2->begin(); aj != mol2->end(); aj++) {
-				distances.push_back (MDSystem::Distance(*ai,*aj).Magnitude());
+				double r2 = MDSystem::Distance(*ai,*aj).squaredNorm();
+				if (min < 0.0 || r2 < min) min = r2;
+			}
+		}
+		return sqrt(min);
+	}
+
+	namespace {
+
+		/* The kernels all work from one point a to n points: the separation along each axis is d - box*rint(d/box), which puts it within half a box. A dimension of zero (no periodic boundary) has an inverse of zero, which leaves the separation alone. The points (and so the arithmetic) are in coord_real precision, and the results are written out as doubles. */
+		typedef void (*distance_kernel_t) (const coord_real * a, const coord_real * x, const coord_real * y, const coord_real * z, const int n, const coord_real * box, const coord_real * inv, const bool root, double * out);
+
+		void distances_scalar (const coord_real * a, const coord_real * x, const coord_real * y, const coord_real * z, const int n, const coord_real * box, const coord_real * inv, const bool root, double * out) {
+			for (int k = 0; k < n; k++) {
+				coord_real dx = x[k] - a[0];
+				coord_real dy = y[k] - a[1];
+				coord_real dz = z[k] - a[2];
+				dx -= box[0] * std::rint(dx * inv[0]);
+				dy -= box[1] * std::rint(dy * inv[1]);
+				dz -= box[2] * std::rint(dz * inv[2]);
+				coord_real r2 = dx*dx + dy*dy + dz*dz;
+				out[k] = (root) ? (double)std::sqrt(r2) : (double)r2;
+			}
+			return;
+		}
+
+#if defined(DISTANCE_DISPATCH) && !defined(FLOAT_COORDS)
+		__attribute__((target("avx2")))
+		void distances_avx2 (const double * a, const double * x, const double * y, const double * z, const int n, const double * box, const double * inv, const bool root, double * out) {
+			const __m256d ax = _mm256_set1_pd(a[0]), ay = _mm256_set1_pd(a[1]), az = _mm256_set1_pd(a[2]);
+			const __m256d bx = _mm256_set1_pd(box[0]), by = _mm256_set1_pd(box[1]), bz = _mm256_set1_pd(box[2]);
+			const __m256d ix = _mm256_set1_pd(inv[0]), iy = _mm256_set1_pd(inv[1]), iz = _mm256_set1_pd(inv[2]);
+			const int nearest = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;
+
+			int k = 0;
+			for (; k + 4 <= n; k += 4) {
+				__m256d dx = _mm256_sub_pd (_mm256_loadu_pd(x + k), ax);
+				__m256d dy = _mm256_sub_pd (_mm256_loadu_pd(y + k), ay);
+				__m256d dz = _mm256_sub_pd (_mm256_loadu_pd(z + k), az);
+				dx = _mm256_sub_pd (dx, _mm256_mul_pd (bx, _mm256_round_pd (_mm256_mul_pd (dx, ix), nearest)));
+				dy = _mm256_sub_pd (dy, _mm256_mul_pd (by, _mm256_round_pd (_mm256_mul_pd (dy, iy), nearest)));
+				dz = _mm256_sub_pd (dz, _mm256_mul_pd (bz, _mm256_round_pd (_mm256_mul_pd (dz, iz), nearest)));
+				__m256d r2 = _mm256_add_pd (_mm256_add_pd (_mm256_mul_pd (dx, dx), _mm256_mul_pd (dy, dy)), _mm256_mul_pd (dz, dz));
+				if (root) r2 = _mm256_sqrt_pd (r2);
+				_mm256_storeu_pd (out + k, r2);
+			}
+			distances_scalar (a, x + k, y + k, z + k, n - k, box, inv, root, out + k);
+			return;
+		}
+
+		// the last few points are handled with masked loads and stores rather than a scalar loop
+		__attribute__((target("avx512f")))
+		void distances_avx512 (const double * a, const double * x, const double * y, const double * z, const int n, const double * box, const double * inv, const bool root, double * out) {
+			const __m512d ax = _mm512_set1_pd(a[0]), ay = _mm512_set1_pd(a[1]), az = _mm512_set1_pd(a[2]);
+			const __m512d bx = _mm512_set1_pd(box[0]), by = _mm512_set1_pd(box[1]), bz = _mm512_set1_pd(box[2]);
+			const __m512d ix = _mm512_set1_pd(inv[0]), iy = _mm512_set1_pd(inv[1]), iz = _mm512_set1_pd(inv[2]);
+			const int nearest = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;
+
+			for (int k = 0; k < n; k += 8) {
+				const __mmask8 mask = (n - k >= 8) ? (__mmask8)0xFF : (__mmask8)((1 << (n - k)) - 1);
+				__m512d dx = _mm512_sub_pd (_mm512_maskz_loadu_pd (mask, x + k), ax);
+				__m512d dy = _mm512_sub_pd (_mm512_maskz_loadu_pd (mask, y + k), ay);
+				__m512d dz = _mm512_sub_pd (_mm512_maskz_loadu_pd (mask, z + k), az);
+				dx = _mm512_sub_pd (dx, _mm512_mul_pd (bx, _mm512_roundscale_pd (_mm512_mul_pd (dx, ix), nearest)));
+				dy = _mm512_sub_pd (dy, _mm512_mul_pd (by, _mm512_roundscale_pd (_mm512_mul_pd (dy, iy), nearest)));
+				dz = _mm512_sub_pd (dz, _mm512_mul_pd (bz, _mm512_roundscale_pd (_mm512_mul_pd (dz, iz), nearest)));
+				__m512d r2 = _mm512_add_pd (_mm512_add_pd (_mm512_mul_pd (dx, dx), _mm512_mul_pd (dy, dy)), _mm512_mul_pd (dz, dz));
+				if (root) r2 = _mm512_sqrt_pd (r2);
+				_mm512_mask_storeu_pd (out + k, mask, r2);
+			}
+			return;
+		}
+#elif defined(DISTANCE_DISPATCH)
+		// single precision runs twice the points through a register, and widens the results on the way out
+		__attribute__((target("avx2")))
+		void distances_avx2 (const float * a, const float * x, const float * y, const float * z, const int n, const float * box, const float * inv, const bool root, double * out) {
+			const __m256 ax = _mm256_set1_ps(a[0]), ay = _mm256_set1_ps(a[1]), az = _mm256_set1_ps(a[2]);
+			const __m256 bx = _mm256_set1_ps(box[0]), by = _mm256_set1_ps(box[1]), bz = _mm256_set1_ps(box[2]);
+			const __m256 ix = _mm256_set1_ps(inv[0]), iy = _mm256_set1_ps(inv[1]), iz = _mm256_set1_ps(inv[2]);
+			const int nearest = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;
+
+			int k = 0;
+			for (; k + 8 <= n; k += 8) {
+				__m256 dx = _mm256_sub_ps (_mm256_loadu_ps(x + k), ax);
+				__m256 dy = _mm256_sub_ps (_mm256_loadu_ps(y + k), ay);
+				__m256 dz = _mm256_sub_ps (_mm256_loadu_ps(z + k), az);
+				dx = _mm256_sub_ps (dx, _mm256_mul_ps (bx, _mm256_round_ps (_mm256_mul_ps (dx, ix), nearest)));
+				dy = _mm256_sub_ps (dy, _mm256_mul_ps (by, _mm256_round_ps (_mm256_mul_ps (dy, iy), nearest)));
+				dz = _mm256_sub_ps (dz, _mm256_mul_ps (bz, _mm256_round_ps (_mm256_mul_ps (dz, iz), nearest)));
+				__m256 r2 = _mm256_add_ps (_mm256_add_ps (_mm256_mul_ps (dx, dx), _mm256_mul_ps (dy, dy)), _mm256_mul_ps (dz, dz));
+				if (root) r2 = _mm256_sqrt_ps (r2);
+				_mm256_storeu_pd (out + k, _mm256_cvtps_pd (_mm256_castps256_ps128 (r2)));
+				_mm256_storeu_pd (out + k + 4, _mm256_cvtps_pd (_mm256_extractf128_ps (r2, 1)));
+			}
+			distances_scalar (a, x + k, y + k, z + k, n - k, box, inv, root, out + k);
+			return;
+		}
+
+		__attribute__((target("avx512f")))
+		void distances_avx512 (const float * a, const float * x, const float * y, const float * z, const int n, const float * box, const float * inv, const bool root, double * out) {
+			const __m512 ax = _mm512_set1_ps(a[0]), ay = _mm512_set1_ps(a[1]), az = _mm512_set1_ps(a[2]);
+			const __m512 bx = _mm512_set1_ps(box[0]), by = _mm512_set1_ps(box[1]), bz = _mm512_set1_ps(box[2]);
+			const __m512 ix = _mm512_set1_ps(inv[0]), iy = _mm512_set1_ps(inv[1]), iz = _mm512_set1_ps(inv[2]);
+			const int nearest = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;
+
+			for (int k = 0; k < n; k += 16) {
+				const __mmask16 mask = (n - k >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1 << (n - k)) - 1);
+				__m512 dx = _mm512_sub_ps (_mm512_maskz_loadu_ps (mask, x + k), ax);
+				__m512 dy = _mm512_sub_ps (_mm512_maskz_loadu_ps (mask, y + k), ay);
+				__m512 dz = _mm512_sub_ps (_mm512_maskz_loadu_ps (mask, z + k), az);
+				dx = _mm512_sub_ps (dx, _mm512_mul_ps (bx, _mm512_roundscale_ps (_mm512_mul_ps (dx, ix), nearest)));
+				dy = _mm512_sub_ps (dy, _mm512_mul_ps (by, _mm512_roundscale_ps (_mm512_mul_ps (dy, iy), nearest)));
+				dz = _mm512_sub_ps (dz, _mm512_mul_ps (bz, _mm512_roundscale_ps (_mm512_mul_ps (dz, iz), nearest)));
+				__m512 r2 = _mm512_add_ps (_mm512_add_ps (_mm512_mul_ps (dx, dx), _mm512_mul_ps (dy, dy)), _mm512_mul_ps (dz, dz));
+				if (root) r2 = _mm512_sqrt_ps (r2);
+				// the low and high 8 results are widened and stored separately
+				const __m256 low = _mm512_castps512_ps256 (r2);
+				const __m256 high = _mm256_castpd_ps (_mm512_extractf64x4_pd (_mm512_castps_pd (r2), 1));
+				_mm512_mask_storeu_pd (out + k, (__mmask8)(mask & 0xFF), _mm512_cvtps_pd (low));
+				_mm512_mask_storeu_pd (out + k + 8, (__mmask8)(mask >> 8), _mm512_cvtps_pd (high));
+			}
+			return;
+		}
+#endif
+
+		const char * distance_kernel_name = "scalar";
+
+		distance_kernel_t select_distance_kernel () {
+#ifdef DISTANCE_DISPATCH
+			__builtin_cpu_init ();
+			if (__builtin_cpu_supports ("avx512f")) {
+				distance_kernel_name = "avx512";
+				return distances_avx512;
 			}
+			if (__builtin_cpu_supports ("avx2")) {
+				distance_kernel_name = "avx2";
+				return distances_avx2;
+			}
+#endif
+			return distances_scalar;
+		}
+
+		const distance_kernel_t distance_kernel = select_distance_kernel ();
+
+		// the box (and its inverse) the kernels wrap the separations with
+		void periodic_box (coord_real * box, coord_real * inv) {
+			const VecR dims = MDSystem::Dimensions();
+			for (int i = 0; i < 3; i++) {
+				box[i] = (coord_real)((dims[i] > 0.0) ? dims[i] : 0.0);
+				inv[i] = (coord_real)((dims[i] > 0.0) ? 1.0/dims[i] : 0.0);
+			}
+			return;
+		}
+
+		void one_to_many (const VecR& point, const coord_real * x, const coord_real * y, const coord_real * z, const int n, const bool root, double * out) {
+			coord_real box[3], inv[3];
+			periodic_box (box, inv);
+			const coord_real a[3] = { (coord_real)point[0], (coord_real)point[1], (coord_real)point[2] };
+			distance_kernel (a, x, y, z, n, box, inv, root, out);
+			return;
+		}
+
+		void many_to_many (const coord_real * ax, const coord_real * ay, const coord_real * az, const int na, const coord_real * bx, const coord_real * by, const coord_real * bz, const int nb, const bool root, double * out) {
+			coord_real box[3], inv[3];
+			periodic_box (box, inv);
+			for (int i = 0; i < na; i++) {
+				const coord_real a[3] = { ax[i], ay[i], az[i] };
+				distance_kernel (a, bx, by, bz, nb, box, inv, root, out + (size_t)i * nb);
+			}
+			return;
 		}
-		std::sort(distances.begin(), distances.end());
-		return distances[0];
+
+		// The separations of a block of pairs are gathered into contiguous arrays first, and then wrapped as the distances from the origin
+		void pair_list (const coord_real * x, const coord_real * y, const coord_real * z, const int * pairs, const int npairs, const bool root, double * out) {
+			const int BLOCK = 256;
+			coord_real dx[BLOCK], dy[BLOCK], dz[BLOCK];
+			coord_real box[3], inv[3];
+			periodic_box (box, inv);
+			const coord_real origin[3] = { 0, 0, 0 };
+
+			for (int start = 0; start < npairs; start += BLOCK) {
+				const int n = std::min (BLOCK, npairs - start);
+				const int * pair = pairs + 2*start;
+				for (int k = 0; k < n; k++, pair += 2) {
+					dx[k] = x[pair[1]] - x[pair[0]];
+					dy[k] = y[pair[1]] - y[pair[0]];
+					dz[k] = z[pair[1]] - z[pair[0]];
+				}
+				distance_kernel (origin, dx, dy, dz, n, box, inv, root, out + start);
+			}
+			return;
+		}
+
+	}	// namespace
+
+	void MDSystem::Distances (const VecR& a, const coord_real * x, const coord_real * y, const coord_real * z, const int n, double * out) {
+		one_to_many (a, x, y, z, n, true, out);
+	}
+
+	void MDSystem::DistancesSquared (const VecR& a, const coord_real * x, const coord_real * y, const coord_real * z, const int n, double * out) {
+		one_to_many (a, x, y, z, n, false, out);
+	}
+
+	void MDSystem::Distances (const coord_real * ax, const coord_real * ay, const coord_real * az, const int na, const coord_real * bx, const coord_real * by, const coord_real * bz, const int nb, double * out) {
+		many_to_many (ax, ay, az, na, bx, by, bz, nb, true, out);
+	}
+
+	void MDSystem::DistancesSquared (const coord_real * ax, const coord_real * ay, const coord_real * az, const int na, const coord_real * bx, const coord_real * by, const coord_real * bz, const int nb, double * out) {
+		many_to_many (ax, ay, az, na, bx, by, bz, nb, false, out);
+	}
+
+	void MDSystem::PairDistances (const coord_real * x, const coord_real * y, const coord_real * z, const int * pairs, const int npairs, double * out) {
+		pair_list (x, y, z, pairs, npairs, true, out);
+	}
+
+	void MDSystem::PairDistancesSquared (const coord_real * x, const coord_real * y, const coord_real * z, const int * pairs, const int npairs, double * out) {
+		pair_list (x, y, z, pairs, npairs, false, out);
+	}
+
+	const char * MDSystem::DistanceKernel () { return distance_kernel_name; }
+
+	void MDSystem::SortByDistance (const VecR& point, const AtomStore& store, Atom_it_non_const first, Atom_it_non_const last) {
+		if (std::distance (first, last) < 2) return;
+
+		std::vector<double> store_r2 (store.size());
+		if (store.size())
+			MDSystem::DistancesSquared (point, store.X(), store.Y(), store.Z(), store.size(), &store_r2[0]);
+
+		std::vector<double> r2;
+		r2.reserve (std::distance (first, last));
+		for (Atom_it_non_const it = first; it != last; it++) {
+			const int i = store.Index (*it);
+			r2.push_back ((i >= 0) ? store_r2[i] : MDSystem::Distance ((*it)->Position(), point).squaredNorm());
+		}
+		MDSystem::_OrderByKey (r2, first);
+		return;
 	}
 
 	VecR MDSystem::CalcClassicDipole (MolPtr mol) {
+		VecR dipole;
+		if (mol->CachedDipole (Molecule::CLASSIC_DIPOLE, dipole)) {
+			mol->Dipole(dipole);
+			return dipole;
+		}
+
 		VecR com = mol->UpdateCenterOfMass();
-		VecR dipole = VecR::Zero();
+		dipole.setZero();
 
 		// the dipole is just a sum of the position vectors multiplied by the charges (classical treatment)
 		for (Atom_it it = mol->begin(); it != mol->end(); it++) {
@@ -112,14 +639,20 @@ namespace md_system {
 		}
 
 		mol->Dipole(dipole);
+		mol->CacheDipole (Molecule::CLASSIC_DIPOLE, dipole);
 
 		return (dipole);
 	}
 
 	// Sets the dipole in Debye units
 	VecR MDSystem::CalcWannierDipole (MolPtr mol) {
+		VecR dipole;
+		if (mol->CachedDipole (Molecule::WANNIER_DIPOLE, dipole)) {
+			mol->Dipole(dipole);
+			return dipole;
+		}
 
-		VecR dipole = CalcClassicDipole(mol);
+		dipole = CalcClassicDipole(mol);
 
 		VecR com = mol->CenterOfMass();
 		//VecR com (0.0,0.0,0.0);
@@ -134,6 +667,7 @@ namespace md_system {
 		//mol->Print();
 		//printf ("% 8.3f ) ", dipole.Magnitude()); dipole.Print();
 		mol->Dipole(dipole); //in units of e * Angstroms
+		mol->CacheDipole (Molecule::WANNIER_DIPOLE, dipole);
 
 		return (dipole);
 	}
@@ -3,10 +3,15 @@
 
 #include "vecr.h"
 #include "atom.h"
+#include "atomstore.h"
 #include "molecule.h"
 #include "moleculefactory.h"
+#include "gzipfile.h"
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <iterator>
+#include <pthread.h>
 
 namespace md_system {
 
@@ -21,6 +26,7 @@ namespace md_system {
 			CoordinateFile ();
 
 			virtual ~CoordinateFile () { 
+				this->_StopPrefetch();
 				if (_file != (FILE *)NULL) {
 					fclose (_file); 
 				}
@@ -36,11 +42,26 @@ namespace md_system {
 			virtual void LoadNext () = 0;
 
 			virtual void Rewind () {
-				rewind(this->_file);
+				this->_PositionFile(_header_bytes);
+				_frame = 0;
 				this->LoadNext();
 				_frame = 1;
 			}
 
+			// loads the given frame of the file (counting from 0)
+			virtual void Seek (const int frame);
+			// the number of frames in the file - -1 if the file hasn't been indexed
+			int NumFrames () const { return _num_frames; }
+
+			// starts a reader thread that keeps up to depth frames read ahead of the one being worked on (once it's running, further calls leave it be)
+			virtual void Prefetch (const int depth);
+
+			/* Reads only the coordinates of the given atoms (indices into the frame) from here on - the rest keep whatever values they had, so only the selected atoms are current. An empty selection goes back to reading everything. With refresh > 0, every refresh-th frame is read in full so that the selection can be picked anew from it (see FullFrame). Selecting stops any read-ahead. Formats that can't skip through a frame just keep reading the whole of it. */
+			virtual void Select (const std::vector<int>& indices, const int refresh = 0);
+			const std::vector<int>& Selection () const { return _selection; }
+			// set when every coordinate of the current frame was read
+			bool FullFrame () const { return _selection.empty() || _full_frame; }
+
 			// retrieves coordinates as VecR (3-element vectors)
 			//const coord_t& Coordinate (const int index) const { return _vectors[index]; }
 			//const coord_t& operator() (const int index) const { return _vectors[index]; }
@@ -55,6 +76,9 @@ namespace md_system {
 
 			unsigned int size () 	const { return _size; }
 
+			// the box size of the current frame, for formats that store it
+			const VecR& Dimensions () const { return _dimensions; }
+
 			bool eof () 	const { return _eof; }
 			bool Loaded () const { return !_eof; }
 			unsigned int Frame () 	const { return _frame; }
@@ -64,15 +88,79 @@ namespace md_system {
 			FILE				*_file;				// the file listing all the atom coordinates
 			std::string _path;
 
+			// gzip-compressed trajectories are opened as a stream of the uncompressed data, inflated in the background (see GzipFile)
+			md_files::GzipFile *	_gzip;
+			void _OpenFile (const std::string& path);
+			// size of the (uncompressed) file - -1 if it isn't known
+			long long _FileSize () const;
+
 			unsigned int					_size;				// number of coordinates to parse in each frame (e.g. number of atoms in the system)
 
 			std::vector<double>								_coords;				// array of atomic coordinates
+			VecR															_dimensions;		// Dimensions of the system (box size)
 			//coord_set_t												_vectors;				// set of vectors representing positions
 
 			char _line[1000];
 			int 			_frame;		// The current frame (number of timesteps processed)
 			bool			_eof;		// end of file marker for the coord file
 
+			/* The frame index. Every frame of a binary trajectory takes up the same number of bytes, so the location of any frame in the file is found from the size of the file header and the size of a frame. */
+			long long	_header_bytes;
+			long long	_frame_bytes;
+			int				_num_frames;
+			// sets up the frame index for the open file
+			void _IndexFrames (const long long header_bytes, const long long frame_bytes);
+			// Formats with frames of varying size (e.g. compressed trajectories) keep the offset of every frame instead
+			std::vector<long long>	_frame_offsets;
+			void _IndexFrames (const std::vector<long long>& offsets);
+			// where the given frame starts in the file
+			long long _FrameOffset (const int frame) const {
+				return (_frame_offsets.empty()) ? _header_bytes + (long long)frame * _frame_bytes : _frame_offsets[frame];
+			}
+			// moves the file to the given byte offset - any frames already read ahead are thrown out
+			void _PositionFile (const long long offset);
+
+			/* Selective loading. The selected atoms are gathered into runs of nearby atoms, and each run is a span of bytes at the same place in every frame of a fixed-size binary trajectory. A frame's selection is read one run at a time (or copied out of a memory map) without touching the rest of the frame. */
+			std::vector<int>	_selection;
+			int								_refresh;
+			bool							_full_frame;	// the last frame loaded was read in full
+			// how the formats that select lay out their frames: bytes per coordinate value, and bytes at the end of every frame that are always read (e.g. the box)
+			size_t						_value_bytes;
+			size_t						_trailer_bytes;
+			struct run_t {
+				size_t	offset;		// from the start of the frame
+				size_t	bytes;
+			};
+			std::vector<run_t>	_runs;
+			// sets up the selection for the formats that support it. Returns false if it can't be done for this file
+			bool _SelectAtoms (const std::vector<int>& indices, const int refresh);
+			// whether the given frame is one of those read in full while selecting
+			bool _RefreshFrame (const int frame) const { return _refresh > 0 && frame % _refresh == 0; }
+			// reads the given frame into a buffer laid out like the frame - just the selected runs, or the whole frame on a refresh. Returns false past the end of the file
+			bool _ReadFrame (char * buffer, const int frame);
+
+			/* Read-ahead of frames. A reader thread reads the raw bytes of the upcoming frames into a ring of buffers while the current frame is being worked on. The ring is a single-producer/single-consumer queue: the reader fills the slot at the tail, and LoadNext takes the slot at the head, which stays untouched until the following frame is asked for. */
+			bool											_prefetch;
+			pthread_t									_reader;
+			pthread_mutex_t						_ring_lock;
+			pthread_cond_t						_frame_ready;
+			pthread_cond_t						_slot_free;
+			std::vector< std::vector<char> >	_ring;
+			int												_head, _tail;
+			int												_filled;			// frames read ahead and waiting
+			bool											_held;				// set while the head slot holds the current frame
+			bool											_reader_done;	// the reader hit the end of the file (or was told to stop)
+			bool											_stop_reader;
+
+			bool _Prefetching () const { return _prefetch; }
+			// the raw bytes of the next frame - blocks until the reader has them. Returns NULL once there are no frames left
+			char * _NextFrameBuffer ();
+			void _StartPrefetch ();
+			void _StopPrefetch ();
+			// reads frames into the ring until the end of the file
+			void _ReadAhead ();
+			friend void * read_ahead (void * file);
+
 	};	// Coordinate file
 
 
@@ -86,6 +174,11 @@ namespace md_system {
 			virtual void _ParseMolecules () = 0;
 			bool _parse_molecules;	// this gets set if the molecules are to be parsed to determine the specific types.
 
+			AtomStore	_store;		// structure-of-arrays copy of the system atoms (see Store)
+
+			//! Puts the elements starting at first into the order of their keys, smallest first - ties keep their original order
+			template <class Iter> static void _OrderByKey (const std::vector<double>& keys, Iter first);
+
 		public:
 
 			virtual ~MDSystem();
@@ -94,6 +187,12 @@ namespace md_system {
 			virtual void LoadNext () = 0;
 			//! rewinds the coordinate files
 			virtual void Rewind () = 0;
+			//! jumps to the given frame (counting from 0) of the coordinate files
+			virtual void Seek (const int frame) = 0;
+			//! the number of frames in the coordinate files (-1 if unknown)
+			virtual int NumFrames () const = 0;
+			//! set once a LoadNext has run past the last frame of the coordinate files - the only way to find the end of a trajectory that isn't indexed
+			virtual bool eof () const = 0;
 
 			//! The set of all molecules in a system
 			virtual Mol_ptr_vec& Molecules () = 0;
@@ -115,9 +214,15 @@ namespace md_system {
 
 			virtual int size () const = 0;
 
+			//! The system atoms laid out as structure-of-arrays for the routines that stream over all of them. The store is brought up to the current frame each time this is called, so it's best called once per frame and the store kept on hand
+			const AtomStore& Store ();
+
 			static VecR Dimensions () { return MDSystem::_dimensions; }
 			static void Dimensions (const VecR& dimensions) { MDSystem::_dimensions = dimensions; }
 
+			//! The atoms (by ID) of every molecule with an atom inside [low, high] along the given axis - for loading just that slab of the system (see CoordinateFile::Select)
+			static std::vector<int> SlabAtoms (const Mol_ptr_vec& mols, const int axis, const double low, const double high);
+
 			/* Beyond simple system stats, various computations are done routinely in a molecular dynamics system: */
 
 			// Calculate the distance between two points within a system that has periodic boundaries
@@ -129,6 +234,25 @@ namespace md_system {
 			// Calculates the minimum distance between two molecules - i.e. the shortest inter-molecular atom-pair distance
 			static double Distance (const MolPtr mol1, const MolPtr mol2);
 
+			/* Batched minimum-image distances between points laid out as structure-of-arrays (e.g. the arrays of an AtomStore). Rather than stepping through the periodic images, each separation is wrapped by rounding it against the inverse of the box, and the points are run through 4 or 8 at a time with AVX2 or AVX-512 when the processor has them (the kernel is picked once, when the program starts). The results agree with Distance() to rounding. The Squared versions leave out the square root, for comparing against a cutoff squared. The points are taken in coord_real precision (single precision with FLOAT_COORDS, which also runs twice as many points at a time) - the distances always come out as doubles. */
+
+			// from the point a to each of the n points: out[k] = |p_k - a|
+			static void Distances (const VecR& a, const coord_real * x, const coord_real * y, const coord_real * z, const int n, double * out);
+			static void DistancesSquared (const VecR& a, const coord_real * x, const coord_real * y, const coord_real * z, const int n, double * out);
+			// from each of the na points of one set to each of the nb points of another: out[i*nb + j] = |b_j - a_i|
+			static void Distances (const coord_real * ax, const coord_real * ay, const coord_real * az, const int na, const coord_real * bx, const coord_real * by, const coord_real * bz, const int nb, double * out);
+			static void DistancesSquared (const coord_real * ax, const coord_real * ay, const coord_real * az, const int na, const coord_real * bx, const coord_real * by, const coord_real * bz, const int nb, double * out);
+			// between the points of each listed pair - pairs holds the two indices of each pair one after the other: out[k] = |p_pairs[2k+1] - p_pairs[2k]|
+			static void PairDistances (const coord_real * x, const coord_real * y, const coord_real * z, const int * pairs, const int npairs, double * out);
+			static void PairDistancesSquared (const coord_real * x, const coord_real * y, const coord_real * z, const int * pairs, const int npairs, double * out);
+			// the instruction set the batched distances run on - "avx512", "avx2" or "scalar"
+			static const char * DistanceKernel ();
+
+			//! Orders the atoms in [first, last) by their distance to the point, closest first. The squared distances to all the atoms come out of one batched pass over the store's arrays (an atom that isn't in the store is measured on its own)
+			static void SortByDistance (const VecR& point, const AtomStore& store, Atom_it_non_const first, Atom_it_non_const last);
+			//! Orders molecules (of any molecule pointer type) by the distance of their reference points to the point, closest first. The reference points are gathered up and run through the batched distances together
+			template <class Iter> static void SortByDistance (const VecR& point, Iter first, Iter last);
+
 			//! Calculates a molecular dipole moment using the "classical E&M" method - consider each atom in the molecule as a point-charge, and that the molecule has no net charge (calculation is independent of origin location). This returns a vector that is the sum of the position*charge (r*q) of each atom.
 			static VecR CalcClassicDipole (MolPtr mol);
 
@@ -137,14 +261,52 @@ namespace md_system {
 	};
 
 
+	template <class Iter>
+		void MDSystem::SortByDistance (const VecR& point, Iter first, Iter last) {
+			const int n = (int)std::distance (first, last);
+			if (n < 2) return;
+
+			std::vector<coord_real> px (n), py (n), pz (n);
+			std::vector<double> r2 (n);
+			Iter it = first;
+			for (int k = 0; k < n; k++, it++) {
+				const VecR ref = (*it)->ReferencePoint();
+				px[k] = (coord_real)ref[x];
+				py[k] = (coord_real)ref[y];
+				pz[k] = (coord_real)ref[z];
+			}
+			MDSystem::DistancesSquared (point, &px[0], &py[0], &pz[0], n, &r2[0]);
+			MDSystem::_OrderByKey (r2, first);
+			return;
+		}
+
+	template <class Iter>
+		void MDSystem::_OrderByKey (const std::vector<double>& keys, Iter first) {
+			typedef typename std::iterator_traits<Iter>::value_type value_t;
+
+			std::vector<std::pair<double,int> > order (keys.size());
+			for (int k = 0; k < (int)keys.size(); k++)
+				order[k] = std::make_pair (keys[k], k);
+			std::sort (order.begin(), order.end());
+
+			std::vector<value_t> sorted;
+			sorted.reserve (order.size());
+			for (int k = 0; k < (int)order.size(); k++)
+				sorted.push_back (*(first + order[k].second));
+			std::copy (sorted.begin(), sorted.end(), first);
+			return;
+		}
+
+
 	class vecr_distance_cmp : public std::binary_function <VecR,VecR,bool> {
 		private:
 			VecR reference;
 		public:
 			vecr_distance_cmp (VecR ref) : reference(ref) { }
 			bool operator() (const VecR& v1, const VecR& v2) const {
-				double d1 = MDSystem::Distance (v1, reference).Magnitude();
-				double d2 = MDSystem::Distance (v2, reference).Magnitude();
+				// squared distances order the points the same, without the square roots
+				double d1 = MDSystem::Distance (v1, reference).squaredNorm();
+				double d2 = MDSystem::Distance (v2, reference).squaredNorm();
 				bool ret = (d1 < d2) ? true : false;
 				return ret;
 			};
@@ -152,14 +314,14 @@ namespace md_system {
 
 	class MoleculeToReferenceDistance_cmp : public std::binary_function <MolPtr, MolPtr, bool> {
 		private:
-			MolPtr ref;
+			VecR ref;
 		public:
-			MoleculeToReferenceDistance_cmp (MolPtr mol) : ref(mol) { }
+			MoleculeToReferenceDistance_cmp (MolPtr mol) : ref(mol->ReferencePoint()) { }
 
-			// compare the distances between the waters
+			// compare the distances between the waters (squared - see MDSystem::SortByDistance for sorting a whole set at once)
 			bool operator () (const MolPtr m1, const MolPtr m2) {
-				double distance_1 = MDSystem::Distance (ref->ReferencePoint(), m1->ReferencePoint()).Magnitude();
-				double distance_2 = MDSystem::Distance (ref->ReferencePoint(), m2->ReferencePoint()).Magnitude();
+				double distance_1 = MDSystem::Distance (ref, m1->ReferencePoint()).squaredNorm();
+				double distance_2 = MDSystem::Distance (ref, m2->ReferencePoint()).squaredNorm();
 
 				bool ret = (distance_1 < distance_2) ? true : false;
 				return ret;
@@ -5,12 +5,14 @@ namespace md_system {
 	std::map<Molecule::Molecule_t, int>	numWanniers;
 
 	int Molecule::numMolecules = 0;
+	unsigned int Molecule::_frame_id = 1;
 
 	// A constructor for an empty molecule
 	Molecule::Molecule () :
 		_mass(0.0),
 		_name(""),
 		_moltype(Molecule::NO_MOLECULE) {
+			this->Invalidate();
 			++numMolecules;
 		}
 
@@ -24,6 +26,7 @@ namespace md_system {
 		_ID (oldMol._ID),
 		_moltype(oldMol._moltype),
 		_DCM (oldMol._DCM) {
+			this->Invalidate();
 			this->Rename(oldMol.Name());
 			++numMolecules;
 		}
@@ -56,17 +59,21 @@ namespace md_system {
 	}
 	*/
 
-	// get back the atom pointer to the atom with the given name
+	// get back the atom pointer to the atom with the given name - the name is interned once, and the atoms are matched by name ID
 	AtomPtr Molecule::operator[] (const std::string& atomname) const {
-		Atom_it it = std::find_if( _atoms.begin(), _atoms.end(), member_functional::mem_fun_eq(&Atom::Name, atomname));
+		return (*this)[AtomName(atomname)];
+	}
 
-		// error checking
-		if (it == _atoms.end()) {
-			printf ("\nFrom Molecule::operator[]\n\"The atom named '%s' was not found in the following molecule:\"\n", atomname.c_str());
-			this->Print();
-			exit(1);
+	AtomPtr Molecule::operator[] (const AtomName& atomname) const {
+		const int id = atomname.ID();
+		for (Atom_it it = _atoms.begin(); it != _atoms.end(); it++) {
+			if ((*it)->NameID() == id) return *it;
 		}
-		return(*it);
+
+		// error checking
+		printf ("\nFrom Molecule::operator[]\n\"The atom named '%s' was not found in the following molecule:\"\n", atomname.Name().c_str());
+		this->Print();
+		exit(1);
 	}
 
 	// get back the first atom pointer to the atom with the given element
@@ -93,6 +100,18 @@ namespace md_system {
 		return(patom);
 	}
 
+	void Molecule::Invalidate () {
+		_com_frame = _atoms_frame = _axes_frame = _dcm_frame = _euler_frame = 0;
+		this->InvalidateDipoles();
+		return;
+	}
+
+	void Molecule::InvalidateDipoles () {
+		for (int i = 0; i < NUM_DIPOLE_TYPES; i++)
+			_dipole_frames[i] = 0;
+		return;
+	}
+
 	// same as the operator, but without the syntax
 	void Molecule::AddAtom (AtomPtr const atom) {
 		_atoms.push_back (atom);            // add the central-periodic image of the atom
@@ -113,6 +132,7 @@ namespace md_system {
 
 		// fix the molecular properties affected by the addition of a new atom
 		this->_mass += atom->Mass();
+		this->Invalidate();
 
 		return;
 	}
@@ -136,8 +156,11 @@ namespace md_system {
 		return;
 	}
 
-	// recalculate the center of mass if coordinates are updated
-	VecR Molecule::UpdateCenterOfMass () {
+	// recalculate the center of mass the first time it's needed in a frame
+	VecR Molecule::_CenterOfMass () const {
+		if (this->_Current (_com_frame))
+			return _centerofmass;
+
 		// first zero it out
 		_centerofmass.setZero();
 		_mass = 0.0;
@@ -166,6 +189,7 @@ namespace md_system {
 			(*atom)->Position (axis, 2.0*plane - pos[axis]);
 			//(*atom)->Force (axis, -force[axis]);
 		}
+		this->Invalidate();
 	}
 
 	/*
@@ -218,12 +242,14 @@ namespace md_system {
 			// and then relocate it back to the original origin
 			(*atom)->Shift (origin);
 		}
+		this->Invalidate();
 	}
 
 	*/
 	void Molecule::Shift (VecR& shift) {
 		for (Atom_it it = this->begin(); it != this->end(); it++)
 			(*it)->Shift (shift);
+		this->Invalidate();
 
 		return;
 	}
@@ -245,12 +271,22 @@ namespace md_system {
 		_wanniers.clear();
 		_mass = 0.0;
 		_centerofmass.setZero();
+		this->Invalidate();
 		//_dipole.setZero();
 		_name = "";
 		_ID = 0;
 		_moltype = Molecule::NO_MOLECULE;
 	}
 
+	void Molecule::Recycle () {
+		_atoms.clear();
+		_wanniers.clear();
+		_mass = 0.0;
+		_centerofmass.setZero();
+		this->Invalidate();
+		_ID = -1;
+	}
+
 	double Molecule::MinDistance (Molecule& mol) {
 		// go through the atoms on each molecule and calculate the distance between them, then return the minimum
 		bool first = true;
@@ -277,6 +313,9 @@ namespace md_system {
 
 	// returns the direction cosine matrix to the lab frame from the molecular one
 	MatR const & Molecule::DCMToLab () {
+		if (this->_Current (_dcm_frame))
+			return _DCM;
+
 		// These are the three lab-frame axes
 		VecR X = Vector3d::UnitX();
 		VecR Y = Vector3d::UnitY();
@@ -39,6 +39,13 @@ namespace md_system {
 
 			static int numMolecules;
 
+			/* The quantities derived from the atom positions - the center of mass, the atom roles set by SetAtoms, the molecular axes, the DCM and euler angles, and the dipoles - are cached per frame. Each is calculated the first time it's asked for after a system loads a frame (stamping it with NextFrame), and handed back as-is until the next one.
+				 The molecule's own routines that move atoms (Shift, Reflect, Flip) or change them (AddAtom) throw the cache away themselves, as does setting an atom's charge - anything else that moves a molecule's atoms mid-frame has to call Invalidate. */
+			static void NextFrame () { if (++_frame_id == 0) ++_frame_id; }
+			static unsigned int FrameID () { return _frame_id; }
+			void Invalidate ();						// forgets all the quantities cached for the current frame
+			void InvalidateDipoles ();		// ...or just the dipoles (e.g. when the charges of the atoms are changed - see Atom::Charge)
+
 			// Input functions
 			void Name (std::string name) { _name = name; }	// set the molecule's name
 			void MolID (int ID) { _ID = ID; }
@@ -47,10 +54,11 @@ namespace md_system {
 			// Controls
 			void Shift (VecR& shift);				// Shift the origin of the entire molecule
 			void clear ();							// Erases the molecule data
-			VecR UpdateCenterOfMass ();				// recalculates the center of mass when coordinates are updated
+			void Recycle ();						// Empties out the atoms and wanniers, but keeps the molecule type (and the memory) for reuse
+			VecR UpdateCenterOfMass () { return this->_CenterOfMass(); }		// the center of mass of the current frame
 
 			// Output Functions
-			VecR CenterOfMass () const		{ return _centerofmass; }
+			VecR CenterOfMass () const		{ return this->_CenterOfMass(); }
 			// A reference point within the molecule for comparing positions
 			virtual VecR ReferencePoint () const = 0;
 
@@ -79,12 +87,15 @@ namespace md_system {
 			VecR Y () const					{ return _y; }
 			VecR Z () const					{ return _z; }
 			// setting molecular axes
-			void X (VecR& x_axis) { _x = x_axis; }
-			void Y (VecR& y_axis) { _y = y_axis; }
-			void Z (VecR& z_axis) { _z = z_axis; }
-
-			// Euler angles
-			double * EulerAngles () 		{ return _eulerangles; }
+			void X (VecR& x_axis) { _x = x_axis; this->_AxesChanged(); }
+			void Y (VecR& y_axis) { _y = y_axis; this->_AxesChanged(); }
+			void Z (VecR& z_axis) { _z = z_axis; this->_AxesChanged(); }
+
+			// Euler angles of the current molecular axes
+			double * EulerAngles () {
+				if (!this->_Current (_euler_frame)) this->_FindEulerAngles();
+				return _eulerangles;
+			}
 
 			void Print () const;							// print out all the info of the molecule
 
@@ -94,6 +105,18 @@ namespace md_system {
 			virtual void Dipole (VecR& dip) { _dipole = dip; }
 			virtual VecR Dipole () const { return _dipole; }		// return the dipole of the molecule in Debye units
 
+			// the ways MDSystem calculates dipoles - each is cached separately, as analyses can ask for both in the same frame
+			typedef enum { CLASSIC_DIPOLE = 0, WANNIER_DIPOLE, NUM_DIPOLE_TYPES } Dipole_t;
+			// true (with the dipole copied out) if the given dipole was already calculated for the current frame
+			bool CachedDipole (const Dipole_t type, VecR& dip) const {
+				if (_dipole_frames[type] != _frame_id) return false;
+				dip = _dipoles[type];
+				return true;
+			}
+			void CacheDipole (const Dipole_t type, const VecR& dip) { _dipoles[type] = dip; _dipole_frames[type] = _frame_id; }
+			// hands the molecule a center of mass calculated elsewhere (see MoleculeStore) for the current frame
+			void CacheCenterOfMass (const VecR& com, const double mass) { _centerofmass = com; _mass = mass; _com_frame = _frame_id; }
+
 			virtual void Flip (const coord axis) { }
 			virtual VecR MolecularAxis () { return _z; }
 
@@ -101,9 +124,11 @@ namespace md_system {
 			AtomPtr operator[] (const int index) const { return _atoms[index]; }	// retrieve an atom by array index
 			AtomPtr operator[] (const std::string& atomname) const;			// retrieve a particular atom using its unique name/ID
 			AtomPtr operator[] (const Atom::Element_t elmt) const;
+			AtomPtr operator[] (const AtomName& atomname) const;		// the same as by name, but with the name already interned
 			AtomPtr GetAtom (const int index) const { return _atoms[index]; }
 			AtomPtr GetAtom (const std::string& atomname) const;
 			AtomPtr GetAtom (const Atom::Element_t elmt) const;
+			AtomPtr GetAtom (const AtomName& atomname) const { return (*this)[atomname]; }
 			//int operator+= (Atom * newAtom);					// adds an atom into the molecule
 
 			void AddAtom (AtomPtr const newAtom);					// same as the operator
@@ -117,8 +142,8 @@ namespace md_system {
 			//int operator+= (Molecule& mol);					// Joins two molecules
 
 			// Some stuff to work with wannier centers
-			void AddWannier (const vector_map& wannier) { _wanniers.push_back(wannier); } // adds a wannier center into the molecule
-			void ClearWanniers () { _wanniers.clear(); }	// clear out the entire list
+			void AddWannier (const vector_map& wannier) { _wanniers.push_back(wannier); _dipole_frames[WANNIER_DIPOLE] = 0; } // adds a wannier center into the molecule
+			void ClearWanniers () { _wanniers.clear(); _dipole_frames[WANNIER_DIPOLE] = 0; }	// clear out the entire list
 
 
 			// some functions to manipulate the molecule's position/orientation (symmetry operations)
@@ -207,10 +232,9 @@ namespace md_system {
 			VecR							_dipole;				// the molecular dipole
 			VecR							_x, _y, _z;			// molecular frame axes
 
-			// this is broken last I checked - not updated with coordinate updates
-			VecR			_centerofmass;		// calculate by 1/M * Sum(m[i]*r[i])	where M = total mass, m[i] and r[i] are atom mass and pos
+			mutable VecR			_centerofmass;		// calculate by 1/M * Sum(m[i]*r[i])	where M = total mass, m[i] and r[i] are atom mass and pos
 
-			double			_mass;				// Total molecular mass
+			mutable double			_mass;				// Total molecular mass
 			double			_charge;
 			std::string	_name;				// some text ID or name for the molecule
 			int					_ID;				// A numerical ID for the molecule
@@ -221,6 +245,26 @@ namespace md_system {
 			double			_eulerangles[3];	// the three euler angles theta, phi, chi
 			MatR			_DCM;				// the direction cosine matrix for rotating the molecule to the lab frame
 			void 			_FindEulerAngles ();// Calculates the Euler angles between the molecular axes and the fixed axes
+
+			static unsigned int	_frame_id;		// the frame last loaded by a system - 0 is never used, and marks a stale quantity
+			// the frame each cached quantity was calculated for
+			mutable unsigned int	_com_frame;
+			unsigned int	_atoms_frame, _axes_frame, _dcm_frame, _euler_frame;
+			unsigned int	_dipole_frames[NUM_DIPOLE_TYPES];
+			VecR					_dipoles[NUM_DIPOLE_TYPES];
+
+			// true if the stamped quantity is current - otherwise it's stamped with this frame, to be calculated by the caller
+			bool _Current (unsigned int& stamp) const {
+				if (stamp == _frame_id) return true;
+				stamp = _frame_id;
+				return false;
+			}
+			// the axes were set by hand (or by SetOrderAxes, if order is set) - the DCM and euler angles follow them
+			void _AxesChanged (const bool order = false) {
+				_axes_frame = order ? _frame_id : 0;
+				_dcm_frame = _euler_frame = 0;
+			}
+			VecR _CenterOfMass () const;
 	};
 
 	typedef Molecule::MolPtr MolPtr;
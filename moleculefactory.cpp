@@ -6,7 +6,7 @@ namespace md_system {
 
 		MolPtr mol;
 
-		if (name == "h2o" || name == "wat" || name == "SW" || name == "SM2")
+		if (name == "h2o" || name == "wat" || name == "SW" || name == "SM2" || name == "SOL")
 			mol = new Water;
 		else if (name == "oh")
 			mol = new Hydroxide;
@@ -30,4 +30,55 @@ namespace md_system {
 		return mol;
 	}	// MoleculeFactory
 
+	MolPtr MoleculeFactory (const Molecule::Molecule_t type) {
+
+		MolPtr mol;
+
+		switch (type) {
+			case Molecule::H : mol = new Proton; break;
+			case Molecule::OH : mol = new Hydroxide; break;
+			case Molecule::H2O : mol = new Water; break;
+			case Molecule::H3O : mol = new Hydronium; break;
+			case Molecule::ZUNDEL : mol = new Zundel; break;
+			case Molecule::NO3 : mol = new Nitrate; break;
+			case Molecule::HNO3 : mol = new NitricAcid; break;
+			case Molecule::SO2 : mol = new SulfurDioxide; break;
+			case Molecule::CL : mol = new Chlorine; break;
+			case Molecule::FORMALDEHYDE : mol = new alkane::Formaldehyde; break;
+			case Molecule::MALONIC :
+			case Molecule::MALONATE :
+			case Molecule::DIMALONATE :
+				mol = new alkane::MalonicAcid (type); break;
+			default:
+				std::cerr << "Couldn't create a molecule of type: " << Molecule::Moltype2String(type) << std::endl;
+				exit(1);
+		}
+
+		return mol;
+	}	// MoleculeFactory
+
+
+	MoleculePool::~MoleculePool () {
+		for (pool_map::iterator it = _pool.begin(); it != _pool.end(); it++) {
+			for (Mol_it mol = it->second.begin(); mol != it->second.end(); mol++)
+				delete *mol;
+		}
+	}
+
+	MolPtr MoleculePool::Get (const Molecule::Molecule_t type) {
+		Mol_ptr_vec& pooled = _pool[type];
+		if (pooled.empty())
+			return MoleculeFactory(type);
+
+		MolPtr mol = pooled.back();
+		pooled.pop_back();
+		return mol;
+	}
+
+	void MoleculePool::Release (MolPtr mol) {
+		mol->Recycle();
+		_pool[mol->MolType()].push_back(mol);
+		return;
+	}
+
 }	// namespace md system
@@ -14,6 +14,23 @@
 namespace md_system {
 
 	MolPtr MoleculeFactory (const std::string name);
+	// creates a new molecule of the given type
+	MolPtr MoleculeFactory (const Molecule::Molecule_t type);
+
+	// Holds on to molecules that are no longer in use so that they can be handed out again rather than deleted and re-allocated every time the molecules are parsed. Molecules are pooled by type, and keep the memory of their atom and wannier containers.
+	class MoleculePool {
+		public:
+			~MoleculePool ();
+
+			// a molecule of the given type - a recycled one if any are available
+			MolPtr Get (const Molecule::Molecule_t type);
+			// hands a molecule back to the pool
+			void Release (MolPtr mol);
+
+		protected:
+			typedef std::map<Molecule::Molecule_t, Mol_ptr_vec> pool_map;
+			pool_map _pool;
+	};
 
 }	// namespace molecule
 
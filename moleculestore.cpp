@@ -0,0 +1,241 @@
+#include "moleculestore.h"
+#include "mdsystem.h"
+#include <Eigen/Eigenvalues>
+#include <algorithm>
+#include <cmath>
+
+namespace md_system {
+
+	namespace {
+		// orders molecules by type, then number of atoms, then number of wannier centers
+		struct group_cmp {
+			bool operator() (const MolPtr left, const MolPtr right) const {
+				if (left->MolType() != right->MolType()) return left->MolType() < right->MolType();
+				if (left->size() != right->size()) return left->size() < right->size();
+				return left->Wanniers().size() < right->Wanniers().size();
+			}
+		};
+	}
+
+	MoleculeStore::MoleculeStore () { }
+
+	void MoleculeStore::Update (const Mol_ptr_vec& mols) {
+		if (!this->_Fits (mols))
+			this->_Assign (mols);
+
+		for (std::vector<group_t>::const_iterator group = _groups.begin(); group != _groups.end(); group++) {
+			this->_Gather (*group);
+			this->_Calculate (*group);
+		}
+
+		// the molecules keep the results for the rest of the frame, and take the wannier dipole as their own (as with CalcWannierDipole)
+		for (int i = 0; i < this->size(); i++) {
+			VecR dipole = this->WannierDipole(i);
+			_mols[i]->CacheCenterOfMass (this->CenterOfMass(i), _mass[i]);
+			_mols[i]->CacheDipole (Molecule::CLASSIC_DIPOLE, this->ClassicDipole(i));
+			_mols[i]->CacheDipole (Molecule::WANNIER_DIPOLE, dipole);
+			_mols[i]->Dipole (dipole);
+		}
+		return;
+	}
+
+	int MoleculeStore::Index (const MolPtr mol) const {
+		std::map<MolPtr,int>::const_iterator it = _index.find (mol);
+		return (it == _index.end()) ? -1 : it->second;
+	}
+
+	bool MoleculeStore::_Fits (const Mol_ptr_vec& mols) const {
+		if (mols != _given) return false;
+		// molecules reparsed in place keep their pointers, but may have gained or lost atoms or wannier centers
+		for (std::vector<group_t>::const_iterator group = _groups.begin(); group != _groups.end(); group++) {
+			for (int i = group->first; i < group->first + group->size; i++) {
+				if (_mols[i]->size() != group->atoms || (int)_mols[i]->Wanniers().size() != group->wanniers)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	void MoleculeStore::_Assign (const Mol_ptr_vec& mols) {
+		_given = mols;
+		_mols = mols;
+		std::stable_sort (_mols.begin(), _mols.end(), group_cmp());
+		_index.clear();
+		for (int i = 0; i < (int)_mols.size(); i++)
+			_index[_mols[i]] = i;
+
+		_groups.clear();
+		int widest = 0;
+		for (int i = 0; i < (int)_mols.size(); ) {
+			group_t group;
+			group.type = _mols[i]->MolType();
+			group.atoms = _mols[i]->size();
+			group.wanniers = (int)_mols[i]->Wanniers().size();
+			group.first = i;
+			while (i < (int)_mols.size() && !group_cmp()(_mols[group.first], _mols[i]))
+				++i;
+			group.size = i - group.first;
+			group.stride = (group.size + AtomStore::WIDTH - 1) / AtomStore::WIDTH * AtomStore::WIDTH;
+			_groups.push_back (group);
+
+			const int slots = (group.atoms + group.wanniers) * group.stride;
+			if (slots > widest) widest = slots;
+		}
+
+		const int n = (int)_mols.size();
+		_mass.assign (n, 0.0);
+		for (int c = 0; c < 3; c++) {
+			_com[c].assign (n, 0.0);
+			_classic[c].assign (n, 0.0);
+			_wannier[c].assign (n, 0.0);
+			_moments[c].assign (n, 0.0);
+		}
+		for (int c = 0; c < 9; c++)
+			_axes[c].assign (n, 0.0);
+
+		// the gather arrays are sized for the biggest group, and reused for each
+		_x.assign (widest, 0.0);
+		_y.assign (widest, 0.0);
+		_z.assign (widest, 0.0);
+		_masses.assign (widest, 0.0);
+		_charges.assign (widest, 0.0);
+		for (int c = 0; c < 6; c++)
+			_inertia[c].assign (widest, 0.0);
+		return;
+	}
+
+	// The only pointer-chasing pass - every atom and wannier center of the group is visited once
+	void MoleculeStore::_Gather (const group_t& group) {
+		const int s = group.stride;
+		for (int m = 0; m < group.size; m++) {
+			MolPtr mol = _mols[group.first + m];
+			int k = 0;
+			for (Atom_it atom = mol->begin(); atom != mol->end(); atom++, k++) {
+				const vector_map& r = (*atom)->Position();
+				_x[k*s+m] = r[x];
+				_y[k*s+m] = r[y];
+				_z[k*s+m] = r[z];
+				_masses[k*s+m] = (*atom)->Mass();
+				_charges[k*s+m] = (*atom)->Charge();
+			}
+			for (vector_map_it w = mol->wanniers_begin(); w != mol->wanniers_end(); w++, k++) {
+				_x[k*s+m] = (*w)[x];
+				_y[k*s+m] = (*w)[y];
+				_z[k*s+m] = (*w)[z];
+			}
+		}
+		return;
+	}
+
+	// Every loop runs down the molecules of the group, for one atom (or wannier) slot at a time
+	void MoleculeStore::_Calculate (const group_t& group) {
+		const int n = group.size;
+		const int s = group.stride;
+		const int slots = group.atoms + group.wanniers;
+
+		double * mass = &_mass[group.first];
+		double * cx = &_com[x][group.first];
+		double * cy = &_com[y][group.first];
+		double * cz = &_com[z][group.first];
+
+		// center of mass
+		for (int m = 0; m < n; m++)
+			mass[m] = cx[m] = cy[m] = cz[m] = 0.0;
+		for (int k = 0; k < group.atoms; k++) {
+			const double * mk = &_masses[k*s];
+			const double * xk = &_x[k*s];
+			const double * yk = &_y[k*s];
+			const double * zk = &_z[k*s];
+			for (int m = 0; m < n; m++) {
+				mass[m] += mk[m];
+				cx[m] += xk[m] * mk[m];
+				cy[m] += yk[m] * mk[m];
+				cz[m] += zk[m] * mk[m];
+			}
+		}
+		for (int m = 0; m < n; m++) {
+			cx[m] /= mass[m];
+			cy[m] /= mass[m];
+			cz[m] /= mass[m];
+		}
+
+		// the positions are swapped for their minimum-image separations from the center of mass
+		const VecR box = MDSystem::Dimensions();
+		double * coords[3] = { &_x[0], &_y[0], &_z[0] };
+		const double * centers[3] = { cx, cy, cz };
+		for (int c = 0; c < 3; c++) {
+			const double length = box[c];
+			const double inverse = (length > 0.0) ? 1.0 / length : 0.0;
+			for (int k = 0; k < slots; k++) {
+				double * d = coords[c] + k*s;
+				const double * center = centers[c];
+				for (int m = 0; m < n; m++) {
+					d[m] -= center[m];
+					d[m] -= length * rint(d[m] * inverse);
+				}
+			}
+		}
+
+		// dipoles - the wannier centers carry a charge of -2
+		for (int c = 0; c < 3; c++) {
+			double * classic = &_classic[c][group.first];
+			double * wannier = &_wannier[c][group.first];
+			for (int m = 0; m < n; m++)
+				classic[m] = 0.0;
+			for (int k = 0; k < group.atoms; k++) {
+				const double * d = coords[c] + k*s;
+				const double * q = &_charges[k*s];
+				for (int m = 0; m < n; m++)
+					classic[m] += d[m] * q[m];
+			}
+			for (int m = 0; m < n; m++)
+				wannier[m] = classic[m];
+			for (int k = group.atoms; k < slots; k++) {
+				const double * d = coords[c] + k*s;
+				for (int m = 0; m < n; m++)
+					wannier[m] -= d[m] * 2.0;
+			}
+		}
+
+		// inertia tensor about the center of mass
+		double * inertia[6];
+		for (int c = 0; c < 6; c++) {
+			inertia[c] = &_inertia[c][0];
+			for (int m = 0; m < n; m++)
+				inertia[c][m] = 0.0;
+		}
+		for (int k = 0; k < group.atoms; k++) {
+			const double * mk = &_masses[k*s];
+			const double * dx = &_x[k*s];
+			const double * dy = &_y[k*s];
+			const double * dz = &_z[k*s];
+			for (int m = 0; m < n; m++) {
+				inertia[0][m] += mk[m] * (dy[m]*dy[m] + dz[m]*dz[m]);
+				inertia[1][m] += mk[m] * (dx[m]*dx[m] + dz[m]*dz[m]);
+				inertia[2][m] += mk[m] * (dx[m]*dx[m] + dy[m]*dy[m]);
+				inertia[3][m] -= mk[m] * dx[m]*dy[m];
+				inertia[4][m] -= mk[m] * dx[m]*dz[m];
+				inertia[5][m] -= mk[m] * dy[m]*dz[m];
+			}
+		}
+
+		// the 3x3 eigenproblems are solved a molecule at a time
+		Eigen::SelfAdjointEigenSolver<MatR> solver;
+		MatR tensor;
+		for (int m = 0; m < n; m++) {
+			tensor << inertia[0][m], inertia[3][m], inertia[4][m],
+						 inertia[3][m], inertia[1][m], inertia[5][m],
+						 inertia[4][m], inertia[5][m], inertia[2][m];
+			solver.compute (tensor);
+			const int i = group.first + m;
+			for (int a = 0; a < 3; a++) {
+				_moments[a][i] = solver.eigenvalues()(a);
+				for (int c = 0; c < 3; c++)
+					_axes[3*a+c][i] = solver.eigenvectors()(c,a);
+			}
+		}
+
+		return;
+	}
+
+}	// namespace md system
@@ -0,0 +1,84 @@
+#ifndef MOLECULESTORE_H_
+#define MOLECULESTORE_H_
+
+#include "molecule.h"
+#include "atomstore.h"
+#include <vector>
+#include <map>
+
+namespace md_system {
+
+	/* The center of mass, the classic and wannier dipoles, and the principal axes of every molecule in a set, calculated together for a frame.
+
+		 The molecules are grouped by type, number of atoms and number of wannier centers. A group's positions are gathered once per frame into arrays laid out slot-major - the first atom of every molecule in the group, then the second atom of every molecule, and so on - so each quantity is calculated by running down the molecules of the group in a plain loop over contiguous doubles, which the compiler can vectorize. The results land in per-molecule arrays (entry i of each belongs to Molecules(i), and the molecules of a group sit next to each other), and are handed to the molecules' own per-frame caches as well, so MDSystem::CalcClassicDipole, CalcWannierDipole and Molecule::CenterOfMass return them for the rest of the frame. Each molecule's Dipole is set to its wannier dipole, as CalcWannierDipole would.
+
+		 Separations from the center of mass are wrapped into the box by rounding against its inverse, so the dipoles agree with CalcClassicDipole and CalcWannierDipole to rounding. The principal axes are the eigenvectors of the inertia tensor about the center of mass, sorted by increasing moment (the sign of each axis is arbitrary).
+	 */
+	class MoleculeStore {
+
+		public:
+
+			MoleculeStore ();
+
+			// brings the store up to the current frame for the given molecules - the grouping is redone whenever the molecules (or their atom or wannier counts) change
+			void Update (const Mol_ptr_vec& mols);
+
+			int size () const { return (int)_mols.size(); }
+			MolPtr Molecules (const int i) const { return _mols[i]; }
+			// where the molecule sits in the store - -1 if it isn't in it
+			int Index (const MolPtr mol) const;
+
+			// the groups of molecules of the same type and size - molecules first through first+size-1
+			struct group_t {
+				Molecule::Molecule_t	type;
+				int		atoms, wanniers;		// per molecule
+				int		first, size;
+				int		stride;						// between the slots of the gathered positions (size padded for alignment)
+			};
+			int NumGroups () const { return (int)_groups.size(); }
+			const group_t& Group (const int g) const { return _groups[g]; }
+
+			double Mass (const int i) const { return _mass[i]; }
+			VecR CenterOfMass (const int i) const { return VecR (_com[x][i], _com[y][i], _com[z][i]); }
+			VecR ClassicDipole (const int i) const { return VecR (_classic[x][i], _classic[y][i], _classic[z][i]); }
+			VecR WannierDipole (const int i) const { return VecR (_wannier[x][i], _wannier[y][i], _wannier[z][i]); }
+			// the principal moments of inertia, smallest first, and the axes that go with them
+			VecR Moments (const int i) const { return VecR (_moments[0][i], _moments[1][i], _moments[2][i]); }
+			VecR Axis (const int i, const int axis) const { return VecR (_axes[3*axis][i], _axes[3*axis+1][i], _axes[3*axis+2][i]); }
+
+			// the arrays themselves, one coordinate at a time
+			const double * Masses () const { return &_mass[0]; }
+			const double * CentersOfMass (const coord axis) const { return &_com[axis][0]; }
+			const double * ClassicDipoles (const coord axis) const { return &_classic[axis][0]; }
+			const double * WannierDipoles (const coord axis) const { return &_wannier[axis][0]; }
+
+		protected:
+			typedef std::vector<double, Eigen::aligned_allocator<double> >	aligned_vec;
+
+			Mol_ptr_vec						_mols;			// grouped
+			std::vector<group_t>	_groups;
+
+			// lays the store out for the molecules
+			void _Assign (const Mol_ptr_vec& mols);
+			// whether the layout still fits the molecules
+			bool _Fits (const Mol_ptr_vec& mols) const;
+			// gathers the positions, masses and charges of a group, and calculates its quantities
+			void _Gather (const group_t& group);
+			void _Calculate (const group_t& group);
+
+			// results, by molecule
+			aligned_vec		_mass;
+			aligned_vec		_com[3], _classic[3], _wannier[3];
+			aligned_vec		_moments[3], _axes[9];
+
+			// the gathered group, slot-major (atoms, then wanniers), and its scratch space
+			aligned_vec		_x, _y, _z, _masses, _charges;
+			aligned_vec		_inertia[6];		// xx, yy, zz, xy, xz, yz
+
+			Mol_ptr_vec			_given;		// the molecules as they were handed in, to spot changes
+			std::map<MolPtr,int>	_index;
+	};	// molecule store
+
+}	// namespace md system
+
+#endif
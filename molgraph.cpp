@@ -36,14 +36,14 @@ namespace molgraph {
 	void MoleculeGraph::BuildGraph (Vertex v, const bondgraph::BondGraph& graph) {
 
 		// build the queue of connected atoms
-		Atom_ptr_vec bonded_atoms = graph.BondedAtoms (_graph[v].atom, bondgraph::covalent);	// only covalently-bound atoms
+		bondgraph::BondGraph::Bond_range bonds = graph.Bonds (_graph[v].atom);
 		std::list<Vertex> queue;
 		//printf ("adding:\n");
-		for (Atom_it it = bonded_atoms.begin(); it != bonded_atoms.end(); it++) {
-			// only queue up atoms that are not already in the graph
-			if (!InGraph(*it)) {
-				//(*it)->Print();
-				Vertex w = AddAtomToGraph(*it);
+		for (bondgraph::BondGraph::Bond_it it = bonds.first; it != bonds.second; it++) {
+			// only covalently-bound atoms, and only queue up atoms that are not already in the graph
+			if (it->btype == bondgraph::covalent && !InGraph(it->atom)) {
+				//it->atom->Print();
+				Vertex w = AddAtomToGraph(it->atom);
 				queue.push_back(w);
 			}
 		}
@@ -5,73 +5,88 @@ namespace molgraph {
 	// given a molgraph, find out what molecule it is, and then create a new one
 	MolPtr MoleculeGraph2Molecule (MoleculeGraph& molgraph) {
 
-		atomcounter atomcount;
-		MolPtr newmol = (MolPtr)NULL;
-
+		ElementSignature sig;
 		Atom_ptr_vec atoms (molgraph.Atoms());
 		for (Atom_it at = atoms.begin(); at != atoms.end(); at++) {
-			atomcount[(*at)->Element()]++;
+			sig.Add((*at)->Element());
+		}
+
+		MolPtr newmol = Signature2Molecule (atoms, sig);
+		if (newmol == (MolPtr)NULL) {
+			MolgraphIdentificationError (molgraph);
 		}
 
-		int C_count = AtomCount(atomcount, Atom::C);
-		int N_count = AtomCount(atomcount, Atom::N);
-		int O_count = AtomCount(atomcount, Atom::O);
-		int S_count = AtomCount(atomcount, Atom::S);
-		int H_count = AtomCount(atomcount, Atom::H);
-		int Cl_count = AtomCount(atomcount, Atom::Cl);
-		int Total_count = C_count + N_count + O_count + S_count + H_count + Cl_count;
+		return newmol;
+	}
+
+	// a new molecule of the given type - recycled from the pool if there is one
+	static MolPtr CreateMolecule (const Molecule::Molecule_t type, MoleculePool * pool) {
+		return (pool) ? pool->Get(type) : MoleculeFactory(type);
+	}
+
+	MolPtr Signature2Molecule (Atom_ptr_vec& atoms, const ElementSignature& sig, MoleculePool * pool) {
+
+		MolPtr newmol = (MolPtr)NULL;
+
+		int C_count = sig.C;
+		int N_count = sig.N;
+		int O_count = sig.O;
+		int S_count = sig.S;
+		int H_count = sig.H;
+		int Cl_count = sig.Cl;
+		int Total_count = sig.Total();
 
 		if (Cl_count == Total_count) {
-			newmol = new Chlorine ();
+			newmol = CreateMolecule (Molecule::CL, pool);
 		}
 
 		// check for organics/alkanes
 		else if (C_count == 3) {
 			if (H_count == 4 && O_count == 4)
-				newmol = new alkane::MalonicAcid (Molecule::MALONIC);
+				newmol = CreateMolecule (Molecule::MALONIC, pool);
 			else if (H_count == 3 && O_count == 4)
-				newmol = new alkane::MalonicAcid (Molecule::MALONATE);
+				newmol = CreateMolecule (Molecule::MALONATE, pool);
 			else if (H_count == 2 && O_count == 4)
-				newmol = new alkane::MalonicAcid (Molecule::DIMALONATE);
+				newmol = CreateMolecule (Molecule::DIMALONATE, pool);
 			//else if (H_count > 4 || O_count != 4) {
 			else {
 				//std::cerr << "----------- Right here --------------" << std::endl;
 				//MolgraphIdentificationError (molgraph);
 				//fflush(stdout);
 				//exit(1);
-				newmol = new alkane::MalonicAcid (Molecule::MALONIC);
+				newmol = CreateMolecule (Molecule::MALONIC, pool);
 			}
 
 		}
 
 		// parse out formaldehydes
 		else if (C_count == 1 && O_count == 1 && H_count == 2 && Total_count == 4) {
-			newmol = new alkane::Formaldehyde ();
+			newmol = CreateMolecule (Molecule::FORMALDEHYDE, pool);
 		}
 
 		// check for nitrates
 		else if (N_count == 1 && O_count == 3 && H_count == 1) {
-			newmol = new NitricAcid ();
+			newmol = CreateMolecule (Molecule::HNO3, pool);
 		}
 		else if (N_count == 1 && O_count == 3 && H_count == 0) {
-			newmol = new Nitrate ();
+			newmol = CreateMolecule (Molecule::NO3, pool);
 		}
 
 		else if (H_count == 1 && Total_count == 1) {
-			newmol = new Proton ();
+			newmol = CreateMolecule (Molecule::H, pool);
 		}
 		// check for non-organics with an oxygen
 		else if (O_count == 1 && H_count == 1 && Total_count == 2) {
-			newmol = new Hydroxide ();
+			newmol = CreateMolecule (Molecule::OH, pool);
 		}
 		else if (O_count == 1 && H_count == 2 && Total_count == 3) {
-			newmol = new Water ();
+			newmol = CreateMolecule (Molecule::H2O, pool);
 		}
 		else if (O_count == 1 && H_count == 3 && Total_count == 4) {
-			newmol = new Hydronium ();
+			newmol = CreateMolecule (Molecule::H3O, pool);
 		}
 		else if (O_count == 2 && H_count == 5 && Total_count == 7) {
-			newmol = new Zundel ();
+			newmol = CreateMolecule (Molecule::ZUNDEL, pool);
 		}
 		else if (O_count == 1 && H_count >= 2) {
 			Atom_ptr_vec temp;
@@ -79,7 +94,7 @@ namespace molgraph {
 			atoms.clear();
 			std::copy (temp.begin(), temp.begin()+3, std::back_inserter(atoms));
 
-			newmol = new Water ();
+			newmol = CreateMolecule (Molecule::H2O, pool);
 		}
 
 		// check for non-organics with an oxygen (i.e. so2)
@@ -90,7 +105,7 @@ namespace molgraph {
 			atoms.clear();
 			std::copy (temp.begin(), temp.begin()+3, std::back_inserter(atoms));
 
-			newmol = new SulfurDioxide ();
+			newmol = CreateMolecule (Molecule::SO2, pool);
 		}
 
 		// if some other glob of Os and Hs
@@ -100,7 +115,7 @@ namespace molgraph {
 		//}
 
 		else {
-			MolgraphIdentificationError (molgraph);
+			return (MolPtr)NULL;
 		}
 
 		// add all the atoms into the new molecule
@@ -2,15 +2,40 @@
 #define MOLGRAPHFACTORY_H_
 #include "molgraph.h"
 #include "bondgraph.h"
+#include "moleculefactory.h"
 #include <map>
 
 namespace molgraph {
 
 	typedef std::map<Atom::Element_t, int>	atomcounter;
 
+	// the number of atoms of each element in a group of bound atoms - this is all that's needed to tell which molecule the group forms
+	struct ElementSignature {
+		int C, N, O, S, H, Cl;
+		ElementSignature () : C(0), N(0), O(0), S(0), H(0), Cl(0) { }
+
+		void Add (const Atom::Element_t elmt) {
+			switch (elmt) {
+				case Atom::C : C++; break;
+				case Atom::N : N++; break;
+				case Atom::O : O++; break;
+				case Atom::S : S++; break;
+				case Atom::H : H++; break;
+				case Atom::Cl : Cl++; break;
+				default : break;
+			}
+		}
+
+		int Total () const { return C + N + O + S + H + Cl; }
+	};
+
 	// given a molgraph, find out what molecule it is, and then create a new one
 	MolPtr MoleculeGraph2Molecule (MoleculeGraph& molgraph);
 
+	// creates the molecule formed by a group of bound atoms with the given element signature. Returns NULL if the molecule can't be identified.
+	// If a pool is given, the molecule is taken from it rather than allocated.
+	MolPtr Signature2Molecule (Atom_ptr_vec& atoms, const ElementSignature& sig, MoleculePool * pool = (MoleculePool *)NULL);
+
 	// error given when a molgraph can't be figured out
 	void MolgraphIdentificationError (MoleculeGraph& molgraph);
 
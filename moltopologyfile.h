@@ -32,6 +32,11 @@ namespace md_files {
 			MolecularTopologyFile (const std::string filepath = std::string ("topology")) {
 				this->LoadFile (filepath);
 			}
+			// a topology that has already been read in (e.g. from an arcade container)
+			MolecularTopologyFile (const mol_topology_vec& topology) :
+				_topologyFile ((FILE *)NULL),
+				num_mols ((int)topology.size()),
+				mols (topology) { }
 			virtual ~MolecularTopologyFile () { }
 
 			int size () const { return num_mols; }
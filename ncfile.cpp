@@ -0,0 +1,314 @@
+#include "ncfile.h"
+#include "xdr.h"
+
+namespace md_files {
+
+	using namespace gromacs;	// the netcdf classic format is written in xdr, the same as the gromacs trajectories
+
+	// the tags that start each list in the header
+	static const int NC_DIMENSION = 0x0A;
+	static const int NC_VARIABLE = 0x0B;
+	static const int NC_ATTRIBUTE = 0x0C;
+	// the record count of a file that was still being written
+	static const unsigned int NC_STREAMING = 0xFFFFFFFF;
+
+	// the size of each nc_type (byte, char, short, int, float, double)
+	static int nc_type_size (const int type) {
+		static const int sizes[] = { 0, 1, 1, 2, 4, 4, 8 };
+		return (type > 0 && type < 7) ? sizes[type] : 0;
+	}
+
+	// pulls the pieces of the header out of the file one at a time
+	class NCHeaderReader {
+		public:
+			NCHeaderReader (FILE * file, const std::string& path) : _file(file), _path(path) { }
+
+			unsigned int UInt () {
+				unsigned char b[4];
+				this->_Read (b, 4);
+				return xdr::to_uint(b);
+			}
+			int Int () { return (int)this->UInt(); }
+
+			// variable offsets are 4 bytes in the classic format, and 8 in the 64-bit offset format
+			long long Offset (const bool large) {
+				long long offset = this->UInt();
+				if (large)
+					offset = (offset << 32) | this->UInt();
+				return offset;
+			}
+
+			std::string Name () {
+				int length = this->Int();
+				std::vector<char> name (xdr::padded(length) + 1, '\0');
+				this->_Read (&name[0], xdr::padded(length));
+				return std::string (&name[0], length);
+			}
+
+			void Skip (const int bytes) {
+				if (fseeko64 (_file, bytes, SEEK_CUR)) this->_Fail();
+			}
+
+			// attributes aren't needed - they're only skipped over
+			void SkipAttributes () {
+				int tag = this->Int();
+				int num = this->Int();
+				if (tag != NC_ATTRIBUTE && (tag || num)) this->_Fail();
+				for (int i = 0; i < num; i++) {
+					this->Name();
+					int type = this->Int();
+					int nelems = this->Int();
+					this->Skip (xdr::padded(nc_type_size(type) * nelems));
+				}
+			}
+
+		private:
+			FILE *				_file;
+			std::string		_path;
+
+			void _Read (void * buffer, const int bytes) {
+				if (bytes && fread (buffer, 1, bytes, _file) != (size_t)bytes) this->_Fail();
+			}
+			void _Fail () {
+				printf ("NCFile - the header of the netcdf file %s is corrupt or cut short\n", _path.c_str());
+				exit(1);
+			}
+	};
+
+
+	NCFile::NCFile (std::string const ncpath, int const c_size, const bool periodic) :
+		CoordinateFile (ncpath, c_size),
+		_periodic(periodic),
+		_coords_offset(0), _coords_type(NC_FLOAT),
+		_cell_offset(-1), _cell_type(NC_DOUBLE),
+		_map((char *)NULL), _map_size(0),
+		_readahead(0) {
+
+			// the records are read straight out of a map of the file, so it can't be compressed
+			if (_gzip != (GzipFile *)NULL) {
+				printf ("NCFile - %s is a compressed netcdf file. Netcdf trajectories can't be read compressed - decompress it first\n", ncpath.c_str());
+				exit(1);
+			}
+
+			this->_ReadHeader ();
+			if (_periodic && _cell_offset < 0) {
+				printf ("NCFile c-tor - the system is periodic, but the netcdf file %s has no cell_lengths\n", ncpath.c_str());
+				exit(1);
+			}
+
+			_record.resize(_frame_bytes);
+			this->_MapFile ();
+			this->_PositionFile (_header_bytes);
+			LoadNext ();	// load the first frame of the file
+		}
+
+	NCFile::~NCFile () {
+		if (_map != (char *)NULL)
+			munmap (_map, _map_size);
+	}
+
+	bool NCFile::IsNetCDF (const std::string& path) {
+		unsigned char magic[4] = {0, 0, 0, 0};
+		size_t bytes = GzipFile::Peek (path, (char *)magic, 4);
+
+		// netcdf-4 files are hdf5 underneath. They're claimed here too so that they get a sensible error rather than being read as a flat crd file
+		return (bytes == 4) && ((magic[0] == 'C' && magic[1] == 'D' && magic[2] == 'F') || (magic[1] == 'H' && magic[2] == 'D' && magic[3] == 'F'));
+	}
+
+	void NCFile::_ReadHeader () {
+		rewind (_file);
+		NCHeaderReader header (_file, _path);
+
+		unsigned char magic[4];
+		if (fread (magic, 1, 4, _file) != 4 || magic[0] != 'C' || magic[1] != 'D' || magic[2] != 'F' || (magic[3] != 1 && magic[3] != 2)) {
+			printf ("NCFile::_ReadHeader() - %s isn't a netcdf classic or 64-bit offset file. (NetCDF-4/HDF5 and CDF-5 files can be converted with \"nccopy -k 2\")\n", _path.c_str());
+			exit(1);
+		}
+		const bool large = (magic[3] == 2);
+		unsigned int numrecs = header.UInt();
+
+		// dimensions - the record dimension (frames) is the one with length 0
+		std::vector<int> dims;
+		std::vector<std::string> dimnames;
+		int recdim = -1;
+		int tag = header.Int();
+		int num = header.Int();
+		if (tag != NC_DIMENSION && (tag || num)) {
+			printf ("NCFile::_ReadHeader() - couldn't find the dimensions in the header of %s\n", _path.c_str());
+			exit(1);
+		}
+		for (int i = 0; i < num; i++) {
+			dimnames.push_back (header.Name());
+			dims.push_back (header.Int());
+			if (dims.back() == 0) recdim = i;
+		}
+
+		header.SkipAttributes ();
+
+		// variables - each record holds all the variables that run along the record dimension
+		long long record_start = -1;
+		long long record_bytes = 0;
+		int record_vars = 0;
+		long long lone_bytes = 0;
+		long long coords_begin = -1, cell_begin = -1;
+		int coords_dims[3] = {-1, -1, -1};
+
+		tag = header.Int();
+		num = header.Int();
+		if (tag != NC_VARIABLE && (tag || num)) {
+			printf ("NCFile::_ReadHeader() - couldn't find the variables in the header of %s\n", _path.c_str());
+			exit(1);
+		}
+		for (int i = 0; i < num; i++) {
+			std::string name = header.Name();
+			int ndims = header.Int();
+			std::vector<int> dimids (ndims, 0);
+			for (int d = 0; d < ndims; d++)
+				dimids[d] = header.Int();
+			header.SkipAttributes ();
+			int type = header.Int();
+			header.UInt();		// vsize - worked out below, as it overflows for big variables
+			long long begin = header.Offset(large);
+
+			if (ndims == 0 || dimids[0] != recdim) continue;
+
+			long long bytes = nc_type_size(type);
+			for (int d = 1; d < ndims; d++)
+				bytes *= dims[dimids[d]];
+			record_bytes += (bytes + 3) & ~3LL;
+			++record_vars;
+			if (record_start < 0 || begin < record_start)
+				record_start = begin;
+
+			if (name == "coordinates") {
+				coords_begin = begin;
+				_coords_type = type;
+				for (int d = 0; d < 3 && d < ndims; d++)
+					coords_dims[d] = dims[dimids[d]];
+				if (ndims != 3) coords_dims[0] = -1;
+			}
+			else if (name == "cell_lengths") {
+				cell_begin = begin;
+				_cell_type = type;
+			}
+			lone_bytes = bytes;
+		}
+		// a lone record variable isn't padded out
+		if (record_vars == 1)
+			record_bytes = lone_bytes;
+
+		if (coords_begin < 0 || coords_dims[0] < 0 || coords_dims[1] != (int)_size || coords_dims[2] != 3 || (_coords_type != NC_FLOAT && _coords_type != NC_DOUBLE)) {
+			printf ("NCFile::_ReadHeader() - %s doesn't hold coordinates for %d atoms in the Amber layout (frame, atom, spatial)\n", _path.c_str(), (int)_size);
+			exit(1);
+		}
+		if (_cell_type != NC_FLOAT && _cell_type != NC_DOUBLE) cell_begin = -1;
+
+		_coords_offset = coords_begin - record_start;
+		_cell_offset = (cell_begin < 0) ? -1 : cell_begin - record_start;
+
+		this->_IndexFrames (record_start, record_bytes);
+		if (numrecs != NC_STREAMING && _num_frames > (int)numrecs)
+			_num_frames = (int)numrecs;
+
+		return;
+	}
+
+	// maps the whole file into memory. If that can't be done the records are read in with fread instead
+	void NCFile::_MapFile () {
+		struct stat st;
+		if (fstat (fileno(_file), &st) || !S_ISREG(st.st_mode) || st.st_size == 0) return;
+
+		void * map = mmap (NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(_file), 0);
+		if (map == MAP_FAILED) return;
+
+		_map = (char *)map;
+		_map_size = (size_t)st.st_size;
+		madvise (_map, _map_size, MADV_SEQUENTIAL);
+		return;
+	}
+
+	void NCFile::LoadNext () {
+
+		const unsigned char * record;
+		if (_map != (char *)NULL) {
+			if (_frame >= _num_frames) {
+				_eof = true;
+				return;
+			}
+			record = (const unsigned char *)(_map + this->_FrameOffset(_frame));
+
+			// page in the records that come up next while this one is processed
+			if (_readahead > 0 && _frame+1 < _num_frames) {
+				size_t page = (size_t)sysconf(_SC_PAGESIZE);
+				size_t next = (size_t)this->_FrameOffset(_frame+1);
+				size_t start = next - next % page;
+				size_t end = (size_t)this->_FrameOffset(std::min(_frame+1+_readahead, _num_frames));
+				madvise (_map + start, std::min(end, _map_size) - start, MADV_WILLNEED);
+			}
+		}
+		else if (this->_Prefetching()) {
+			record = (const unsigned char *)this->_NextFrameBuffer();
+		}
+		else {
+			record = &_record[0];
+			if (fread (&_record[0], 1, _record.size(), _file) != _record.size())
+				record = (const unsigned char *)NULL;
+		}
+
+		// the last full frame is left in place at the end of the trajectory
+		if (record == (const unsigned char *)NULL) {
+			_eof = true;
+			return;
+		}
+
+		this->_DecodeRecord (record);
+		++_frame;
+		return;
+	}
+
+	void NCFile::_DecodeRecord (const unsigned char * record) {
+		const unsigned char * coords = record + _coords_offset;
+		const int n = (int)_coords.size();
+		if (_coords_type == NC_FLOAT) {
+			for (int i = 0; i < n; i++)
+				_coords[i] = xdr::to_float(coords + 4*i);
+		}
+		else {
+			for (int i = 0; i < n; i++)
+				_coords[i] = xdr::to_double(coords + 8*i);
+		}
+
+		if (_cell_offset >= 0) {
+			const unsigned char * cell = record + _cell_offset;
+			for (int i = 0; i < 3; i++)
+				_dimensions[i] = (_cell_type == NC_FLOAT) ? xdr::to_float(cell + 4*i) : xdr::to_double(cell + 8*i);
+		}
+		return;
+	}
+
+	void NCFile::Seek (const int frame) {
+		if (_map == (char *)NULL) {
+			CoordinateFile::Seek (frame);
+			return;
+		}
+		if (frame < 0 || frame >= _num_frames) {
+			printf ("NCFile::Seek() - frame %d is out of range. The file %s has %d frames\n", frame, _path.c_str(), _num_frames);
+			exit(1);
+		}
+		// records are read straight out of the map, so seeking is only a matter of picking the record
+		_frame = frame;
+		_eof = false;
+		this->LoadNext ();
+		return;
+	}
+
+	void NCFile::Prefetch (const int depth) {
+		if (_map != (char *)NULL) {
+			_readahead = std::max(depth, 0);
+			return;
+		}
+		CoordinateFile::Prefetch (depth);
+		return;
+	}
+
+}	// namespace md_files
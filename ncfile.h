@@ -0,0 +1,54 @@
+#ifndef NCFILE_H_
+#define NCFILE_H_
+
+#include "mdsystem.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+
+// Class for reading Amber NetCDF trajectories (e.g. mdcrd.nc) without the netcdf library
+
+namespace md_files {
+
+	/* Amber writes its NetCDF trajectories in the classic (CDF-1) or 64-bit offset (CDF-2) layout: a header describing the dimensions and variables, followed by one record per frame. Each record holds every per-frame variable (time, coordinates, cell lengths and angles, velocities...) back to back, so every record is the same size and sits at a fixed offset in the file. Only the header is parsed here - the coordinates and cell lengths are then pulled out of each record, big-endian, straight from a memory map of the file (or with fread when the file can't be mapped). */
+	class NCFile : public md_system::CoordinateFile {
+
+		public:
+
+			NCFile (std::string const ncpath, int const c_size, const bool periodic = true);
+			virtual ~NCFile ();
+
+			void LoadNext ();
+			void Rewind () { this->Seek(0); }
+			void Seek (const int frame);
+			void Prefetch (const int depth);
+
+			// the netcdf magic number that starts the file ("CDF") - compressed files are checked on their uncompressed data
+			static bool IsNetCDF (const std::string& path);
+
+		protected:
+			bool			_periodic;
+
+			// nc_type values of the variables that are read
+			enum { NC_FLOAT = 5, NC_DOUBLE = 6 };
+
+			// where the coordinates and cell lengths are found within a record, and how they're stored
+			long long	_coords_offset;
+			int				_coords_type;
+			long long	_cell_offset;			// -1 when the file has no box
+			int				_cell_type;
+
+			char *		_map;
+			size_t		_map_size;
+			int				_readahead;		// frames paged in ahead of the current one
+
+			std::vector<unsigned char>	_record;		// one record, when reading without the map
+
+			void _ReadHeader ();
+			void _MapFile ();
+			void _DecodeRecord (const unsigned char * record);
+	};
+
+}	// namespace md_files
+#endif
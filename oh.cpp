@@ -15,6 +15,7 @@ namespace md_system {
 	}
 
 	void Hydroxide::SetAtoms () {
+		if (this->_Current (_atoms_frame)) return;
 		_o = this->GetAtom("O");
 		_h = this->GetAtom("H");
 
@@ -149,6 +149,7 @@ namespace morita {
 
 		// the X-axis is just the cross product of the other two
 		_x = (_y % _z).normalized();
+		this->_AxesChanged ();
 
 		return;
 	}
@@ -25,6 +25,7 @@ namespace md_system {
 	}
 
 	void SulfurDioxide::SetAtoms () {
+		if (this->_Current (_atoms_frame)) return;
 
 		_s = this->GetAtom(Atom::S);
 		_o1 = (AtomPtr)NULL; _o2 = (AtomPtr)NULL;
@@ -59,6 +60,7 @@ namespace md_system {
 	 * x-axis = y % z
 	 */
 	void SulfurDioxide::SetOrderAxes () {
+		if (this->_Current (_axes_frame)) return;
 
 		this->SetAtoms ();
 
@@ -70,6 +72,7 @@ namespace md_system {
 
 		// and the x-axis is easy
 		_x = (_y % _z).normalized();
+		this->_AxesChanged (true);
 
 		return;
 	}
@@ -2,6 +2,7 @@
 #define DIPOLE_ANALYSIS_H_
 
 #include "analysis.h"
+#include "moleculestore.h"
 //#include "manipulators.h"
 
 namespace md_analysis {
@@ -19,6 +20,7 @@ namespace md_analysis {
 				void Analysis ();
 
 				VecR_vec dipoles;
+				MoleculeStore molecules;		// the wannier dipoles of all the molecules, each frame
 
 				typedef Atom_ptr_vec::iterator	Atom_ncit;	// non-const iterators
 
@@ -86,12 +88,14 @@ namespace md_analysis {
 				}
 			}
 			
-			// calculate the dipole of each molecule
-			std::transform (this->begin_mols(), this->end_mols(), std::back_inserter(dipoles), std::ptr_fun(&MDSystem::CalcWannierDipole));
+			// calculate the dipole of each molecule - all in one go, and the molecules keep them
+			molecules.Update (this->Mols());
+			for (Mol_it it = this->begin_mols(); it != this->end_mols(); it++)
+				dipoles.push_back ((*it)->Dipole());
 
 			// then grab the 5 waters nearest the so2
 			// by sorting them according to the distance to the so2
-			std::sort (wats.begin(), wats.end(), MoleculeToReferenceDistance_cmp (so2));
+			MDSystem::SortByDistance (so2->ReferencePoint(), wats.begin(), wats.end());
 
 			//VecR dipole = std::accumulate (dipoles.begin(), dipoles.end(), VecR(0.0,0.0,0.0), vecr_add());
 			VecR dipole (0.,0.,0.);
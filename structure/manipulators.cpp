@@ -149,7 +149,7 @@ namespace h2o_analysis {
 	// sort all the waters in the system by distance to a given reference atom
 	void H2OSystemManipulator::FindClosestWaters (const AtomPtr a) {
 		this->UpdateAnalysisWaters();
-		std::sort(analysis_waters.begin(), analysis_waters.end(), typename system_t::molecule_distance_cmp(a));
+		MDSystem::SortByDistance (a->Position(), analysis_waters.begin(), analysis_waters.end());
 	} // find closest waters
 
 
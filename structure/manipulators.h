@@ -50,10 +50,7 @@ namespace md_analysis {
 			void OrderAtomsByDistance (AtomPtr ap) {
 				this->Reload();
 				reference_atom = ap;
-				std::sort(
-						this->analysis_atoms.begin(), 
-						this->analysis_atoms.end(), 
-						typename system_t::atomic_distance_cmp (ap));
+				MDSystem::SortByDistance (ap->Position(), this->_system->Store(), this->analysis_atoms.begin(), this->analysis_atoms.end());
 			}
 
 			// iterate over the atoms sorted by distance - but only over a particular element.
@@ -91,10 +91,7 @@ namespace neighbor_analysis {
 
 		this->LoadAll();
 		// sort the atoms in the system in order of distance from the SO2
-		std::sort(
-				this->begin(), 
-				this->end(), 
-				typename system_t::atomic_distance_cmp (so2s.S()));
+		MDSystem::SortByDistance (so2s.S()->Position(), this->Store(), this->begin(), this->end());
 
 		//nearest.clear();
 		//std::copy (this->begin(), this->begin+20, std::back_inserter(nearest));
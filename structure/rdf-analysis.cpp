@@ -2,6 +2,12 @@
 
 namespace md_analysis {
 
+	// picks an atom's distance to the reference atom out of the batched distances over the store - an atom that isn't in the store is measured on its own
+	static double stored_distance (const AtomStore& store, const double * distances, const AtomPtr ref, const AtomPtr atom) {
+		const int i = store.Index (atom);
+		return (i >= 0) ? distances[i] : MDSystem::Distance (ref, atom).norm();
+	}
+
 	void RDFAnalyzer::Analysis () {
 
 		this->LoadAll();
@@ -14,6 +20,11 @@ namespace md_analysis {
 		// find the waters
 		this->LoadWaters();
 
+		// the distances from the so2-S to every atom of the system come out of one batched pass over the atom store
+		const AtomStore& store = this->Store();
+		std::vector<double> distances (store.size());
+		MDSystem::Distances (so2->S()->Position(), store.X(), store.Y(), store.Z(), store.size(), &distances[0]);
+
 		WaterPtr wat, wat2;
 		double distance;
 		for (Mol_it mol = this->begin_wats(); mol != this->end_wats(); mol++) {
@@ -23,7 +34,7 @@ namespace md_analysis {
 				//wat2 = static_cast<WaterPtr>(*mol2);
 
 				// get distances from so2-S to water-O
-				distance = MDSystem::Distance (so2->S(), wat->O()).Magnitude();
+				distance = stored_distance (store, &distances[0], so2->S(), wat->O());
 				histo(distance);
 
 				/*
@@ -114,21 +125,23 @@ namespace md_analysis {
 		RDFAgent * rdf = FindRDFAgent (position.second);
 		//succ->SetDihedralAtoms();
 
-		double distance;
 		// alcohol oxygens are O1 and O3
 		// carbonyl oxygens are O2 and O4
 		AtomPtr o1 = succ->GetAtom ("O2");
 		AtomPtr o2 = succ->GetAtom ("O4");
 
+		// the distances from both oxygens to every atom of the system, batched over the atom store - the water hydrogens are picked out of them
+		const AtomStore& store = this->Store();
+		const int n = store.size();
+		std::vector<double> distances (2*n);
+		MDSystem::Distances (o1->Position(), store.X(), store.Y(), store.Z(), n, &distances[0]);
+		MDSystem::Distances (o2->Position(), store.X(), store.Y(), store.Z(), n, &distances[n]);
+
 		for (Wat_it wat = h2os.begin(); wat != h2os.end(); wat++) {
-			distance = MDSystem::Distance (o1, (*wat)->H1()).norm();
-			rdf->operator()(distance);
-			distance = MDSystem::Distance (o1, (*wat)->H2()).norm();
-			rdf->operator()(distance);
-			distance = MDSystem::Distance (o2, (*wat)->H1()).norm();
-			rdf->operator()(distance);
-			distance = MDSystem::Distance (o2, (*wat)->H2()).norm();
-			rdf->operator()(distance);
+			rdf->operator()(stored_distance (store, &distances[0], o1, (*wat)->H1()));
+			rdf->operator()(stored_distance (store, &distances[0], o1, (*wat)->H2()));
+			rdf->operator()(stored_distance (store, &distances[n], o2, (*wat)->H1()));
+			rdf->operator()(stored_distance (store, &distances[n], o2, (*wat)->H2()));
 		}
 
 		return;
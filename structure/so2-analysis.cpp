@@ -8,9 +8,10 @@ namespace so2_analysis {
 		//AtomPtr o1 = this->mol->O1();
 		//AtomPtr o2 = this->mol->O2();
 
+		static const AtomName oxygen ("O");
 		AtomPtr h1, h2;
 		for (Mol_it wat = this->begin_wats(); wat != this->end_wats(); wat++) {
-			distance = MDSystem::Distance(s, (*wat)->GetAtom("O")).norm();
+			distance = MDSystem::Distance(s, (*wat)->GetAtom(oxygen)).norm();
 			rdf(distance);
 			/*
 			h1 = (*wat)->GetAtom("H1");
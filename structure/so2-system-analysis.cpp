@@ -86,7 +86,7 @@ namespace so2_analysis {
 			}
 		}
 
-		std::sort (wats.begin(), wats.end(), MoleculeToReferenceDistance_cmp (so2s.SO2()));
+		MDSystem::SortByDistance (so2s.SO2()->ReferencePoint(), wats.begin(), wats.end());
 
 		double angle;
 		for (int i = 0; i < 3; i++) {
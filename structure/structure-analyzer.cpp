@@ -5,7 +5,7 @@ int main (int argc, char**argv) {
 	if (argc < 2) {
 		printf ("Run this program using the following syntax:\n");
 		printf ("structure-analyzer <system-type>\n\n");
-		printf ("%d) Amber System\n%d) XYZ System\n\n", (int)md_analysis::AMBER, (int)md_analysis::XYZ);
+		printf ("%d) Amber System\n%d) XYZ System\n%d) Gromacs System (trr)\n%d) Gromacs System (xtc)\n\n", (int)md_analysis::AMBER, (int)md_analysis::XYZ, (int)md_analysis::TRR, (int)md_analysis::XTC);
 		exit(1);
 	}
 
@@ -19,12 +19,10 @@ int main (int argc, char**argv) {
 		md_analysis::StructureAnalyzer<md_files::AmberSystem> sa(analysis_choice);
 	else if (system_choice == md_analysis::XYZ)
 		md_analysis::StructureAnalyzer<md_files::XYZSystem> sa(analysis_choice);
-	/*
-	else if (system_choice == TRR)
+	else if (system_choice == md_analysis::TRR)
 		md_analysis::StructureAnalyzer<gromacs::GMXSystem< gromacs::TRRFile> > sa(analysis_choice);
-	else if (system_choice == XTC)
+	else if (system_choice == md_analysis::XTC)
 		md_analysis::StructureAnalyzer<gromacs::GMXSystem< gromacs::XTCFile> > sa(analysis_choice);
-		*/
 
 	return 0;
 }
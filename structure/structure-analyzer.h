@@ -70,6 +70,12 @@ namespace md_analysis {
 		// do some initial setup
 		an.Setup();
 
+		// pick up the analysis partway through the trajectory
+		if (Analyzer::restart > 0) {
+			analyzer->Seek (Analyzer::restart);
+			an.LoadAll();
+		}
+
 		// start the analysis - run through each timestep
 		for (Analyzer::timestep = 0; Analyzer::timestep < Analyzer::timesteps; Analyzer::timestep++) 
 		{
@@ -82,8 +88,14 @@ namespace md_analysis {
 			if (analyzer->ReadyToOutputData())
 				an.DataOutput();
 
-			// load the next timestep
+			// load the next timestep - unless this was the last one. An unindexed trajectory (e.g. plain gzip) can run out before the timesteps do, and then the analysis stops with the frames it had
+			if (Analyzer::timestep + 1 >= Analyzer::timesteps) continue;
 			analyzer->LoadNext();
+			if (analyzer->eof()) {
+				Analyzer::timestep++;
+				printf ("\nThe trajectory ran out after %d timesteps\n", Analyzer::timestep);
+				break;
+			}
 		}
 		// do one final data output to push out the finalized data set
 		an.DataOutput();
@@ -171,6 +183,34 @@ namespace md_analysis {
 		}
 
 
+	//! The analyses of water structure that can be run on gromacs systems
+	template <>
+		void StructureAnalyzer< gromacs::GMXSystem<gromacs::TRRFile> >::LoadSystemAnalyses () {
+			sys = new GMXWaterSystem<gromacs::TRRFile> ();
+			analyzer = new Analyzer (sys);
+
+			analyses.push_back (new H2OAngleBondAnalysis(analyzer));
+			analyses.push_back (new density::MolecularDensityDistribution(analyzer));
+			analyses.push_back (new angle_analysis::H2OAngleAnalysis(analyzer));
+			analyses.push_back (new angle_analysis::WaterOHAngleAnalysis(analyzer));
+			analyses.push_back (new h2o_analysis::WaterDipoleZComponentAnalysis(analyzer));
+			analyses.push_back (new h2o_analysis::WaterThetaPhiAnalysis(analyzer));
+		}
+
+	template <>
+		void StructureAnalyzer< gromacs::GMXSystem<gromacs::XTCFile> >::LoadSystemAnalyses () {
+			sys = new GMXWaterSystem<gromacs::XTCFile> ();
+			analyzer = new Analyzer (sys);
+
+			analyses.push_back (new H2OAngleBondAnalysis(analyzer));
+			analyses.push_back (new density::MolecularDensityDistribution(analyzer));
+			analyses.push_back (new angle_analysis::H2OAngleAnalysis(analyzer));
+			analyses.push_back (new angle_analysis::WaterOHAngleAnalysis(analyzer));
+			analyses.push_back (new h2o_analysis::WaterDipoleZComponentAnalysis(analyzer));
+			analyses.push_back (new h2o_analysis::WaterThetaPhiAnalysis(analyzer));
+		}
+
+
 	template <typename T>
 		void StructureAnalyzer<T>::PromptForAnalysisFunction () {
 
@@ -1,3 +1,6 @@
+#ifndef THREADING_H_
+#define THREADING_H_
+
 //#include <boost/thread/thread.hpp>
 #include "pthread.h"
 
@@ -9,20 +12,22 @@ namespace threads {
 	 *
 	 * numbering starts at 0 for index
 	 */
-	int block_low (const int& id, const int& p, const int& n) {
+	inline int block_low (const int& id, const int& p, const int& n) {
 		return id*n/p;
 	}
 
-	int block_high (const int& id, const int& p, const int& n) {
+	inline int block_high (const int& id, const int& p, const int& n) {
 		return block_low (id+1,p,n) - 1;
 	}
 
-	int block_size (const int& id, const int& p, const int& n) {
+	inline int block_size (const int& id, const int& p, const int& n) {
 		return block_low (id+1,p,n) - block_low(id,p,n);
 	}
 
-	int block_owner (int& id, int& p, int& n) {
+	inline int block_owner (int& id, int& p, int& n) {
 		return (p*(id+1)-1)/n;
 	}
 
 }	// namespace threads
+
+#endif
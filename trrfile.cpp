@@ -0,0 +1,136 @@
+#include "trrfile.h"
+#include <sys/stat.h>
+
+namespace gromacs {
+
+	TRRFile::TRRFile (const std::string path) :
+		CoordinateFile (path),
+		_step(0), _time(0.0) {
+
+			this->_IndexTRRFrames();
+			if (_num_frames < 1) {
+				printf ("TRRFile c-tor - Couldn't find any frames in the trr file %s\n", path.c_str());
+				exit(1);
+			}
+
+			this->_PositionFile (_FrameOffset(0));
+			LoadNext ();	// load the first frame of the file
+		}
+
+	int TRRFile::_ReadHeader (FrameHeader& header) {
+
+		// magic number, and the version string ("GMX_trn_file") stored as its size with the null, then as an xdr string
+		unsigned char buffer[256];
+		if (fread (buffer, 1, 12, _file) != 12) return 0;
+		if (xdr::to_int(buffer) != TRRFile::MAGIC) {
+			printf ("TRRFile::_ReadHeader() - bad magic number in frame %d of %s\n", (int)_frame_offsets.size(), _path.c_str());
+			return 0;
+		}
+		int version_bytes = xdr::padded(xdr::to_int(buffer+8));
+		if (version_bytes < 0 || version_bytes > 128) return 0;
+
+		// then the version string, and the 13 ints giving the block sizes, number of atoms, and step
+		int bytes = version_bytes + 13*4;
+		if (fread (buffer, 1, bytes, _file) != (size_t)bytes) return 0;
+		const unsigned char * p = buffer + version_bytes;
+		int * sizes[] = { &header.ir_size, &header.e_size, &header.box_size, &header.vir_size, &header.pres_size, &header.top_size, &header.sym_size, &header.x_size, &header.v_size, &header.f_size, &header.natoms, &header.step, &header.nre };
+		for (int i = 0; i < 13; i++)
+			*sizes[i] = xdr::to_int(p + 4*i);
+
+		if (header.ir_size || header.e_size || header.top_size || header.sym_size) {
+			printf ("TRRFile::_ReadHeader() - frame %d of %s holds blocks that can't be read (input record, energies, or topology)\n", (int)_frame_offsets.size(), _path.c_str());
+			exit(1);
+		}
+
+		// the precision of the file is found from the size of one of the blocks
+		if (header.box_size)
+			header.real_size = header.box_size / 9;
+		else if (header.natoms && header.x_size)
+			header.real_size = header.x_size / (3*header.natoms);
+		else if (header.natoms && header.v_size)
+			header.real_size = header.v_size / (3*header.natoms);
+		else if (header.natoms && header.f_size)
+			header.real_size = header.f_size / (3*header.natoms);
+		else
+			header.real_size = 4;
+		if (header.real_size != 4 && header.real_size != 8) {
+			printf ("TRRFile::_ReadHeader() - couldn't work out the precision of frame %d of %s\n", (int)_frame_offsets.size(), _path.c_str());
+			exit(1);
+		}
+
+		// time and lambda
+		if (fread (buffer, 1, 2*header.real_size, _file) != (size_t)(2*header.real_size)) return 0;
+		header.time = this->_Real (buffer, header.real_size);
+		header.lambda = this->_Real (buffer + header.real_size, header.real_size);
+
+		return 12 + bytes + 2*header.real_size;
+	}
+
+	void TRRFile::_IndexTRRFrames () {
+		std::vector<long long> offsets;
+
+		// unknown (-1) for compressed files not written by bgzip
+		const long long file_size = this->_FileSize();
+
+		FrameHeader header;
+		long long offset = 0;
+		rewind (_file);
+		int header_bytes;
+		while ((header_bytes = this->_ReadHeader(header))) {
+			if (offsets.empty())
+				_size = header.natoms;
+
+			long long bytes = header_bytes + header.DataBytes();
+			// a frame cut off at the end of the file is left out
+			if (file_size >= 0 && offset + bytes > file_size) break;
+
+			offsets.push_back(offset);
+			offset += bytes;
+			fseeko64 (_file, offset, SEEK_SET);
+		}
+
+		_coords.resize(3*_size, 0.0);
+		this->_IndexFrames (offsets);
+		return;
+	}
+
+	void TRRFile::LoadNext () {
+
+		FrameHeader header;
+		if (!this->_ReadHeader(header)) {
+			_eof = true;
+			return;
+		}
+		if (header.natoms != (int)_size) {
+			printf ("TRRFile::LoadNext() - frame %d of %s has %d atoms instead of %d\n", _frame, _path.c_str(), header.natoms, (int)_size);
+			exit(1);
+		}
+
+		_data.resize(header.DataBytes());
+		if (!_data.empty() && fread (&_data[0], 1, _data.size(), _file) != _data.size()) {
+			_eof = true;
+			return;
+		}
+		_step = header.step;
+		_time = header.time;
+
+		const int real = header.real_size;
+		const unsigned char * block = _data.empty() ? (const unsigned char *)NULL : &_data[0];
+		if (header.box_size) {
+			// only the diagonal of the box is used
+			for (int i = 0; i < 3; i++)
+				_dimensions[i] = 10.0 * this->_Real (block + real*(3*i+i), real);
+		}
+		block += header.box_size + header.vir_size + header.pres_size;
+
+		// frames without positions (e.g. velocities only) leave the last positions in place
+		if (header.x_size) {
+			for (int i = 0; i < 3*header.natoms; i++)
+				_coords[i] = 10.0 * this->_Real (block + real*i, real);
+		}
+
+		++_frame;
+		return;
+	}
+
+}	// namespace gromacs
@@ -0,0 +1,51 @@
+#ifndef TRRFILE_H_
+#define TRRFILE_H_
+
+#include "mdsystem.h"
+#include "xdr.h"
+
+// Class for reading full-precision GROMACS trajectories (.trr)
+
+namespace gromacs {
+
+	/* Each trr frame starts with a header that gives the size of each of the blocks that follow it (box, virial, pressure, positions, velocities, forces), and whether the values are floats or doubles. Frames can hold different blocks, so they're indexed by skipping from header to header when the file is opened. Positions are converted from nm to angstroms. */
+	class TRRFile : public md_system::CoordinateFile {
+
+		public:
+
+			TRRFile (const std::string path);
+			virtual ~TRRFile () { }
+
+			void LoadNext ();
+
+			int Step () const { return _step; }
+			double Time () const { return _time; }
+
+			static const int MAGIC = 1993;
+
+		protected:
+			int				_step;
+			double		_time;
+
+			struct FrameHeader {
+				int ir_size, e_size, box_size, vir_size, pres_size, top_size, sym_size, x_size, v_size, f_size;
+				int natoms, step, nre;
+				int real_size;		// 4 for single-precision files, 8 for double
+				double time, lambda;
+				long long DataBytes () const { return (long long)box_size + vir_size + pres_size + x_size + v_size + f_size; }
+			};
+
+			std::vector<unsigned char>	_data;		// the data blocks of a frame
+
+			// reads the header at the current position in the file. Returns the number of bytes read, or 0 if there wasn't a full header
+			int _ReadHeader (FrameHeader& header);
+			// finds where each frame starts in the file
+			void _IndexTRRFrames ();
+			// converts a block of num reals from the frame data
+			double _Real (const unsigned char * data, const int real_size) const {
+				return (real_size == 8) ? xdr::to_double(data) : xdr::to_float(data);
+			}
+	};
+
+}	// namespace gromacs
+#endif
@@ -30,7 +30,8 @@ typedef Eigen::Vector3f VecF;
 //typedef Eigen::MatrixBase<VecR>	vector_base;
 typedef Eigen::MatrixBase<Eigen::Matrix<double, 3, 1, 2, 3, 1> >	vector_base;
 //typedef Eigen::MapBase<Eigen::Matrix<double, 3, 1, 2, 3, 1> >		vector_map_base;
-typedef Eigen::Map<VecR,Aligned> vector_map;
+// Positions are mapped onto arrays of packed xyz triplets, so only every other one of them starts on a 16-byte boundary - the maps can't claim to be aligned
+typedef Eigen::Map<VecR> vector_map;
 typedef std::vector<vector_map>		vector_map_vec;
 typedef vector_map_vec::iterator vector_map_it;
 typedef vector_map_it wannier_it;
@@ -46,6 +47,13 @@ typedef VecF_vec VecF_list;
 typedef VecF_vec::const_iterator VecF_it;
 typedef VecF_vec::iterator VecF_it_non_const;
 
+/* Precision of the packed position arrays that the per-frame distance work runs over - the bondgraph's neighbor search and bond detection, the AtomStore coordinates, the batched MDSystem distances (and the RDFs and neighbor sorts built on them) and the cell grid binning. Building with -DFLOAT_COORDS stores them as floats, which halves the memory they take up (and the bandwidth to sweep them) in large systems - most trajectories are only written to single precision anyway. The atoms themselves, and any sums and distances worked out from the positions, stay in double precision. */
+#ifdef FLOAT_COORDS
+typedef float coord_real;
+#else
+typedef double coord_real;
+#endif
+
 // mapped coordinates
 typedef Eigen::Map<VecR>	coord_t;
 typedef std::vector<coord_t> coord_set_t;
@@ -9,28 +9,57 @@ namespace md_files {
 	//std::map<Molecule::Molecule_t, int> WannierFile::numWanniers;
 	
 	WannierFile::WannierFile (std::string wannierpath) 
-		: CoordinateFile() {
+		: CoordinateFile(),
+		_arcade((ArcadeReader *)NULL),
+		_text((XYZTextReader *)NULL) {
+
+			// containers and text files are read straight off the disk, so only binary wannier files can be compressed
+			if (wannierpath != "" && GzipFile::IsGzip (wannierpath) && (arcade::IsArcadeFile (wannierpath) || XYZTextReader::IsTextFile (wannierpath))) {
+				printf ("WannierFile - %s is a compressed arcade or text xyz file. Only binary wannier files can be read compressed - decompress it first\n", wannierpath.c_str());
+				exit(1);
+			}
 
 			// check if the file is empty (i.e. no wannier file requested
-			if (wannierpath != "") {
-				// first load up the file given the path
-				this->_file = fopen64 (wannierpath.c_str(), "rb");
-				if (!this->_file) {
-					printf ("WannierFile c-tor - Couldn't open the wannier file specified:\n\t%s\n", wannierpath.c_str());
-					exit(1);
+			if (wannierpath != "" && arcade::IsArcadeFile (wannierpath)) {
+				_arcade = new ArcadeReader (wannierpath, arcade::WANNIERS);
+				this->_path = wannierpath;
+				this->_size = _arcade->size();
+				this->_coords.resize(_size*3, 0.0);
+				for (int i = 0; i < this->_size; i++)
+					_wanniers.push_back(vector_map (&(this->_coords[3*i])));
+
+				if (this->_size) {
+					this->_eof = false;
+					this->_num_frames = _arcade->NumFrames();
 				}
-				else {
-					this->_eof = feof(this->_file);
-
-					// grab info from the header: number of centers
-					fread(&(this->_size), sizeof(unsigned int), 1, _file);
-					this->_coords.resize(_size*3, 0.0);
-
-					_wanniers.clear();
-					for (int i = 0; i < this->_size; i++) {
-						//_wanniers.push_back (Eigen::Map<VecR> (&(this->_coords[3*i])));
-						_wanniers.push_back(vector_map (&(this->_coords[3*i])));
-					}
+				else
+					printf ("The arcade file %s has no wannier centers - continuing without them\n", wannierpath.c_str());
+			}
+			else if (wannierpath != "" && XYZTextReader::IsTextFile (wannierpath)) {
+				_text = new XYZTextReader (wannierpath);
+				this->_path = wannierpath;
+				this->_size = _text->size();
+				this->_coords.resize(_size*3, 0.0);
+				for (int i = 0; i < this->_size; i++)
+					_wanniers.push_back(vector_map (&(this->_coords[3*i])));
+				this->_eof = false;
+				this->_num_frames = _text->NumFrames();
+			}
+			else if (wannierpath != "") {
+				// first load up the file given the path
+				this->_OpenFile (wannierpath);
+				this->_eof = feof(this->_file);
+
+				// grab info from the header: number of centers
+				fread(&(this->_size), sizeof(unsigned int), 1, _file);
+				this->_coords.resize(_size*3, 0.0);
+				this->_path = wannierpath;
+				this->_IndexFrames (sizeof(unsigned int), 3 * sizeof(double) * this->_size);
+
+				_wanniers.clear();
+				for (int i = 0; i < this->_size; i++) {
+					//_wanniers.push_back (Eigen::Map<VecR> (&(this->_coords[3*i])));
+					_wanniers.push_back(vector_map (&(this->_coords[3*i])));
 				}
 			}
 			else {
@@ -58,12 +87,73 @@ namespace md_files {
 	}
 
 	WannierFile::~WannierFile () { 
-		fclose(this->_file); 
+		this->_StopPrefetch();
+		if (this->_file != (FILE *)NULL)
+			fclose(this->_file); 
 		this->_file = (FILE *)NULL;
+		delete _arcade;
+		delete _text;
+	}
+
+	void WannierFile::Seek (const int frame) {
+		if (_arcade == (ArcadeReader *)NULL && _text == (XYZTextReader *)NULL) {
+			CoordinateFile::Seek (frame);
+			return;
+		}
+		if (frame < 0 || frame >= _num_frames) {
+			printf ("WannierFile::Seek() - frame %d is out of range. The file %s has %d frames\n", frame, _path.c_str(), _num_frames);
+			exit(1);
+		}
+		this->_frame = frame;
+		this->_eof = false;
+		this->LoadNext();
+		return;
+	}
+
+	void WannierFile::Prefetch (const int depth) {
+		if (_arcade != (ArcadeReader *)NULL) {
+			_arcade->Prefetch (depth > 0);
+			return;
+		}
+		// text files are parsed a chunk of frames at a time instead
+		if (_text != (XYZTextReader *)NULL)
+			return;
+		CoordinateFile::Prefetch (depth);
+		return;
 	}
 
 	void WannierFile::LoadNext () {
 
+		if (_arcade != (ArcadeReader *)NULL) {
+			if (this->_frame >= this->_num_frames) {
+				this->_eof = true;
+				return;
+			}
+			VecR box;
+			_arcade->LoadFrame (this->_frame, &(this->_coords[0]), box);
+			++this->_frame;
+			return;
+		}
+
+		if (_text != (XYZTextReader *)NULL) {
+			if (this->_frame >= this->_num_frames) {
+				this->_eof = true;
+				return;
+			}
+			_text->LoadFrame (this->_frame, &(this->_coords[0]));
+			++this->_frame;
+			return;
+		}
+
+		if (this->_Prefetching()) {
+			const char * frame = this->_NextFrameBuffer();
+			if (frame == (const char *)NULL)
+				this->_eof = true;
+			else
+				memcpy (&this->_coords[0], frame, _frame_bytes);
+			return;
+		}
+
 		//double a, b, c;
 		// grab each coordinate vector for each wannier center until the size of the system is processed
 		for (int i = 0; i < this->_size; i++) {
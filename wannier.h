@@ -2,6 +2,8 @@
 #define WANNIER_H_
 
 #include "mdsystem.h"
+#include "arcadefile.h"
+#include "xyztext.h"
 
 
 namespace md_files {
@@ -14,6 +16,11 @@ namespace md_files {
 			typedef std::vector<vector_map>	vec_vec_map;
 			vec_vec_map _wanniers;
 
+			// the wannier centers can also be stored alongside the coordinates in an arcade container
+			ArcadeReader *	_arcade;
+			// or read straight out of the text file written by CP2K
+			XYZTextReader *	_text;
+
 		public:
 			WannierFile (std::string wannierpath);
 			~WannierFile ();
@@ -36,6 +43,11 @@ namespace md_files {
 
 			// Various control functions
 			void LoadNext ();
+			void Rewind () { this->Seek(0); }
+			void Seek (const int frame);
+			void Prefetch (const int depth);
+			// number of threads used to parse a text wannier file
+			void TextThreads (const int num) { if (_text != (XYZTextReader *)NULL) _text->Threads(num); }
 	};
 
 }
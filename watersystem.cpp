@@ -58,22 +58,6 @@ namespace md_system {
 	}
 
 
-	/*
-		 void WaterSystem< gromacs::GMXSystem<gromacs::TRRFile> >::_InitializeSystem () {
-		 std::string gro = this->SystemParameterLookup("system.files.gmx-grofile");
-		 std::string trr = this->SystemParameterLookup("system.files.gmx-trrfile");
-		 this->sys = new gromacs::GMXSystem< gromacs::TRRFile >(gro.c_str(), trr.c_str());
-		 return;
-		 }
-
-		 void WaterSystem< gromacs::GMXSystem<gromacs::XTCFile> >::_InitializeSystem () {
-		 std::string gro = this->SystemParameterLookup("system.files.gmx-grofile");
-		 std::string xtc = this->SystemParameterLookup("system.files.gmx-xtcfile");
-		 this->sys = new gromacs::GMXSystem< gromacs::XTCFile >(gro.c_str(), xtc.c_str());
-		 return;
-		 }
-		 */
-
 	void WaterSystem::LoadAll () {
 
 		sys_mols.clear();
@@ -4,7 +4,7 @@
 #include "mdsystem.h"
 #include "ambersystem.h"
 #include "xyzsystem.h"
-//#include "gmxsystem.h"
+#include "gmxsystem.h"
 
 #include "utility.h"
 
@@ -108,10 +108,12 @@ namespace md_system {
 				class WaterInSlice : public std::binary_function<U, Double_pair, bool> {
 					private:
 						AtomPositionInSlice apis;
+						AtomName oxygen;
 					public:
+						WaterInSlice () : oxygen("O") { }
 						bool operator() (const U wat, const Double_pair& extents) const
 						{
-							return apis (wat->GetAtom("O"), extents);
+							return apis (wat->GetAtom(oxygen), extents);
 						}
 				};
 
@@ -176,10 +178,32 @@ namespace md_system {
 			virtual void Initialize () = 0;
 			void LoadNext() const { sys->LoadNext(); }
 			virtual void Rewind() const { sys->Rewind(); }
+			void Seek (const int frame) const { sys->Seek(frame); }
+			int NumFrames () const { return sys->NumFrames(); }
+			bool eof () const { return sys->eof(); }
+			//! the system atoms as structure-of-arrays, brought up to the current frame (see MDSystem::Store)
+			const AtomStore& Store () const { return sys->Store(); }
 
 		protected:
 			MDSystem * sys;	/* System coordinate & files */
 
+			// reads the optional system.trajectory.subset settings, and has the system (anything with a SelectSlab) load only the slab they give
+			template <class S>
+				void _LoadSubset (S * system) {
+					if (!config_file->exists("system.trajectory.subset")) return;
+					int axis = SystemParameterLookup("system.trajectory.subset.axis");
+					double low = SystemParameterLookup("system.trajectory.subset.range")[0];
+					double high = SystemParameterLookup("system.trajectory.subset.range")[1];
+					int refresh = 0;
+					config_file->lookupValue("system.trajectory.subset.refresh", refresh);
+					printf ("\tLoading only the molecules in %.2f - %.2f along axis %d", low, high, axis);
+					if (refresh > 0)
+						printf (", picked anew every %d frames\n", refresh);
+					else
+						printf ("\n");
+					system->SelectSlab (axis, low, high, refresh);
+				}
+
 	};	// class watersystem
 
 
@@ -195,8 +219,16 @@ namespace md_system {
 					std::string prmtop = this->SystemParameterLookup("system.files.prmtop");
 					std::string mdcrd = this->SystemParameterLookup("system.files.mdcrd");
 					bool periodic = this->SystemParameterLookup("system.periodic");
-					this->sys = new AmberSystem(prmtop, mdcrd, periodic);
+					AmberSystem * amber = new AmberSystem(prmtop, mdcrd, periodic);
 					printf ("\n\tSystem Files::\n\t\tprmtop = %s\n\t\tmdcrd = %s\n", prmtop.c_str(), mdcrd.c_str());
+
+					int depth = 0;
+					if (config_file->lookupValue("system.trajectory.prefetch-depth", depth) && depth > 0) {
+						printf ("\tReading %d frames ahead of the analysis\n", depth);
+						amber->Prefetch(depth);
+					}
+					this->_LoadSubset (amber);
+					this->sys = amber;
 				}
 				catch (const libconfig::SettingNotFoundException &snfex) {
 					std::cerr << "Couldn't find the Amber system filenames listed in the configuration file" << std::endl;
@@ -232,7 +264,44 @@ namespace md_system {
 					dims.Print();
 
 					std::cout << "new xyz system" << std::endl;
-					this->sys = new XYZSystem(filepath, dims, wanniers);
+					XYZSystem * xyz = new XYZSystem(filepath, dims, wanniers);
+
+					// optional settings for building the bond graph
+					double skin = 0.0;
+					if (config_file->lookupValue("system.bondgraph.verlet-skin", skin) && skin > 0.0) {
+						printf ("\tUsing Verlet neighbor lists with a skin of %.3f\n", skin);
+						xyz->VerletSkin(skin);
+					}
+					int threads = 1;
+					if (config_file->lookupValue("system.bondgraph.threads", threads) && threads > 1) {
+						printf ("\tUsing %d threads to find the bonds\n", threads);
+						xyz->BondThreads(threads);
+					}
+
+					// optional settings for parsing the molecules
+					bool incremental = false;
+					if (config_file->lookupValue("system.molecules.incremental", incremental) && incremental) {
+						printf ("\tOnly reparsing the molecules whose covalent bonds have changed\n");
+						xyz->IncrementalReparse(true);
+					}
+					int reparse_limit = 1;
+					if (config_file->lookupValue("system.molecules.reparse-limit", reparse_limit) && reparse_limit > 1) {
+						printf ("\tReparsing the molecules every %d frames\n", reparse_limit);
+						xyz->SetReparseLimit(reparse_limit);
+					}
+
+					int depth = 0;
+					if (config_file->lookupValue("system.trajectory.prefetch-depth", depth) && depth > 0) {
+						printf ("\tReading %d frames ahead of the analysis\n", depth);
+						xyz->Prefetch(depth);
+					}
+					int text_threads = 1;
+					if (config_file->lookupValue("system.trajectory.text-threads", text_threads) && text_threads > 1) {
+						printf ("\tParsing text frames with %d threads\n", text_threads);
+						xyz->TextThreads(text_threads);
+					}
+					this->_LoadSubset (xyz);
+					this->sys = xyz;
 				}
 				catch (const libconfig::SettingNotFoundException &snfex) {
 					std::cerr << "Couldn't find the xyz system parameters in the configuration file" << std::endl;
@@ -249,6 +318,36 @@ namespace md_system {
 	};	// xyz water system
 
 
+	/* A GROMACS system - the atoms and residues come from the gro file, and the trajectory is read from either a trr or an xtc file (T is gromacs::TRRFile or gromacs::XTCFile) */
+	template <class T>
+		class GMXWaterSystem : public WaterSystem {
+			public:
+				GMXWaterSystem (const std::string configuration_filename = std::string ("system.cfg")) : 
+					WaterSystem (configuration_filename) { }
+				~GMXWaterSystem () { delete this->sys; }
+
+				virtual void Initialize () {
+					try {
+						std::string gro = this->SystemParameterLookup("system.files.gmx-grofile");
+						std::string trajectory = this->SystemParameterLookup(TrajectorySetting());
+						printf ("\n\tSystem Files::\n\t\tgro = %s\n\t\ttrajectory = %s\n", gro.c_str(), trajectory.c_str());
+						this->sys = new gromacs::GMXSystem<T>(gro, trajectory);
+					}
+					catch (const libconfig::SettingNotFoundException &snfex) {
+						std::cerr << "Couldn't find the gromacs system filenames listed in the configuration file" << std::endl;
+						exit(EXIT_FAILURE);
+					}
+					return;
+				}
+
+				// the configuration setting that names the trajectory file
+				static std::string TrajectorySetting ();
+		};	// gmx water system
+
+	template <> inline std::string GMXWaterSystem<gromacs::TRRFile>::TrajectorySetting () { return std::string("system.files.gmx-trrfile"); }
+	template <> inline std::string GMXWaterSystem<gromacs::XTCFile>::TrajectorySetting () { return std::string("system.files.gmx-xtcfile"); }
+
+
 }	// namespace
 
 #endif
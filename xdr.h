@@ -0,0 +1,39 @@
+#ifndef XDR_H_
+#define XDR_H_
+
+#include <cstdio>
+#include <cstring>
+
+namespace gromacs {
+
+	/* GROMACS trajectories are written in XDR - 4-byte big-endian integers and IEEE floats (or doubles), with strings and opaque data padded out to a multiple of 4 bytes. These pull the values out of raw bytes read from a file. */
+	namespace xdr {
+
+		inline unsigned int to_uint (const unsigned char * b) {
+			return ((unsigned int)b[0] << 24) | ((unsigned int)b[1] << 16) | ((unsigned int)b[2] << 8) | (unsigned int)b[3];
+		}
+
+		inline int to_int (const unsigned char * b) { return (int)to_uint(b); }
+
+		inline float to_float (const unsigned char * b) {
+			unsigned int u = to_uint(b);
+			float f;
+			memcpy (&f, &u, sizeof(float));
+			return f;
+		}
+
+		inline double to_double (const unsigned char * b) {
+			unsigned long long u = ((unsigned long long)to_uint(b) << 32) | to_uint(b+4);
+			double d;
+			memcpy (&d, &u, sizeof(double));
+			return d;
+		}
+
+		// the number of bytes that a block of opaque data takes up in the file
+		inline int padded (const int bytes) { return (bytes + 3) & ~3; }
+
+	}	// namespace xdr
+
+}	// namespace gromacs
+
+#endif
@@ -0,0 +1,334 @@
+#include "xtcfile.h"
+#include <sys/stat.h>
+#include <algorithm>
+
+namespace gromacs {
+
+	/* The unpacking below follows the xtc coordinate compression of GROMACS (xdr3dfcoord in libxdrfile). Atoms are written as a full-sized integer triplet, optionally followed by a run of "small" triplets stored as differences from the atom before them. The size of the small differences is taken from the magicints table and adapts as the frame goes along. */
+
+	static const int magicints[] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 0,
+		8, 10, 12, 16, 20, 25, 32, 40, 50, 64,
+		80, 101, 128, 161, 203, 256, 322, 406, 512, 645,
+		812, 1024, 1290, 1625, 2048, 2580, 3250, 4096, 5060, 6501,
+		8192, 10321, 13003, 16384, 20642, 26007, 32768, 41285, 52015, 65536,
+		82570, 104031, 131072, 165140, 208063, 262144, 330280, 416127, 524287, 660561,
+		832255, 1048576, 1321122, 1664510, 2097152, 2642245, 3329021, 4194304, 5284491, 6658042,
+		8388607, 10568983, 13316085, 16777216 };
+
+	static const int FIRSTIDX = 9;
+	static const int LASTIDX = sizeof(magicints) / sizeof(*magicints);
+
+	// header of a frame: magic number, number of atoms, step, time, the box, and the number of atoms again
+	static const int HEADER_BYTES = 4*4 + 9*4 + 4;
+	// the compression parameters that follow the header: precision, minint[3], maxint[3], smallidx, and the byte count of the packed data
+	static const int PACKING_BYTES = 4 + 3*4 + 3*4 + 4 + 4;
+
+	// the number of bits needed to store values from 0 to size
+	static int sizeofint (const int size) {
+		unsigned int num = 1;
+		int num_of_bits = 0;
+		while (size >= (int)num && num_of_bits < 32) {
+			num_of_bits++;
+			num <<= 1;
+		}
+		return num_of_bits;
+	}
+
+	// the number of bits needed to store a set of values that are packed together as one big number
+	static int sizeofints (const int num_of_ints, const unsigned int sizes[]) {
+		unsigned int bytes[32];
+		unsigned int num_of_bytes = 1, num_of_bits = 0, bytecnt, tmp;
+		bytes[0] = 1;
+		for (int i = 0; i < num_of_ints; i++) {
+			tmp = 0;
+			for (bytecnt = 0; bytecnt < num_of_bytes; bytecnt++) {
+				tmp = bytes[bytecnt] * sizes[i] + tmp;
+				bytes[bytecnt] = tmp & 0xff;
+				tmp >>= 8;
+			}
+			while (tmp != 0) {
+				bytes[bytecnt++] = tmp & 0xff;
+				tmp >>= 8;
+			}
+			num_of_bytes = bytecnt;
+		}
+		unsigned int num = 1;
+		num_of_bytes--;
+		while (bytes[num_of_bytes] >= num) {
+			num_of_bits++;
+			num *= 2;
+		}
+		return num_of_bits + num_of_bytes * 8;
+	}
+
+	// reads bits off the front of the packed data
+	class BitReader {
+		public:
+			BitReader (const unsigned char * data) : _data(data), _count(0), _lastbits(0), _lastbyte(0) { }
+
+			int Bits (int num_of_bits) {
+				const int mask = (num_of_bits < 32) ? (1 << num_of_bits) - 1 : -1;
+				int num = 0;
+				while (num_of_bits >= 8) {
+					_lastbyte = (_lastbyte << 8) | _data[_count++];
+					num |= (_lastbyte >> _lastbits) << (num_of_bits - 8);
+					num_of_bits -= 8;
+				}
+				if (num_of_bits > 0) {
+					if ((int)_lastbits < num_of_bits) {
+						_lastbits += 8;
+						_lastbyte = (_lastbyte << 8) | _data[_count++];
+					}
+					_lastbits -= num_of_bits;
+					num |= (_lastbyte >> _lastbits) & ((1 << num_of_bits) - 1);
+				}
+				return num & mask;
+			}
+
+			// unpacks a set of values that were stored as one big number of num_of_bits bits
+			void Ints (const int num_of_ints, int num_of_bits, const unsigned int sizes[], int nums[]) {
+				int bytes[32];
+				int num_of_bytes = 0;
+				bytes[1] = bytes[2] = bytes[3] = 0;
+				while (num_of_bits > 8) {
+					bytes[num_of_bytes++] = this->Bits(8);
+					num_of_bits -= 8;
+				}
+				if (num_of_bits > 0)
+					bytes[num_of_bytes++] = this->Bits(num_of_bits);
+
+				for (int i = num_of_ints-1; i > 0; i--) {
+					unsigned int num = 0;
+					for (int j = num_of_bytes-1; j >= 0; j--) {
+						num = (num << 8) | bytes[j];
+						unsigned int p = num / sizes[i];
+						bytes[j] = p;
+						num = num - p * sizes[i];
+					}
+					nums[i] = num;
+				}
+				nums[0] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
+			}
+
+		private:
+			const unsigned char * _data;
+			int						_count;
+			unsigned int	_lastbits;
+			unsigned int	_lastbyte;
+	};
+
+
+	XTCFile::XTCFile (const std::string path) :
+		CoordinateFile (path),
+		_step(0), _time(0.0) {
+
+			this->_IndexXTCFrames();
+			if (_num_frames < 1) {
+				printf ("XTCFile c-tor - Couldn't find any frames in the xtc file %s\n", path.c_str());
+				exit(1);
+			}
+
+			this->_PositionFile (_FrameOffset(0));
+			LoadNext ();	// load the first frame of the file
+		}
+
+	void XTCFile::_IndexXTCFrames () {
+		std::vector<long long> offsets;
+
+		// unknown (-1) for compressed files not written by bgzip
+		const long long file_size = this->_FileSize();
+
+		unsigned char header[HEADER_BYTES + PACKING_BYTES];
+		long long offset = 0;
+		rewind (_file);
+		while (fread (header, 1, HEADER_BYTES, _file) == (size_t)HEADER_BYTES) {
+			if (xdr::to_int(header) != XTCFile::MAGIC) {
+				printf ("XTCFile::_IndexXTCFrames() - bad magic number in frame %d of %s - ignoring the rest of the file\n", (int)offsets.size(), _path.c_str());
+				break;
+			}
+
+			int natoms = xdr::to_int(header+4);
+			if (offsets.empty())
+				_size = natoms;
+
+			long long bytes = HEADER_BYTES;
+			if (natoms <= 9)
+				bytes += 3 * 4 * natoms;
+			else {
+				if (fread (header + HEADER_BYTES, 1, PACKING_BYTES, _file) != (size_t)PACKING_BYTES) break;
+				bytes += PACKING_BYTES + xdr::padded (xdr::to_int(header + HEADER_BYTES + PACKING_BYTES - 4));
+			}
+
+			// a frame cut off at the end of the file is left out
+			if (file_size >= 0 && offset + bytes > file_size) break;
+
+			offsets.push_back(offset);
+			offset += bytes;
+			fseeko64 (_file, offset, SEEK_SET);
+		}
+
+		_coords.resize(3*_size, 0.0);
+		_ints.resize(3*_size, 0);
+		this->_IndexFrames (offsets);
+		return;
+	}
+
+	void XTCFile::LoadNext () {
+
+		unsigned char header[HEADER_BYTES + PACKING_BYTES];
+		if (fread (header, 1, HEADER_BYTES, _file) != (size_t)HEADER_BYTES) {
+			_eof = true;
+			return;
+		}
+
+		int natoms = xdr::to_int(header+4);
+		if (xdr::to_int(header) != XTCFile::MAGIC || natoms != (int)_size) {
+			printf ("XTCFile::LoadNext() - frame %d of %s is corrupt or has a different number of atoms\n", _frame, _path.c_str());
+			exit(1);
+		}
+		_step = xdr::to_int(header+8);
+		_time = xdr::to_float(header+12);
+		// only the diagonal of the box is used
+		for (int i = 0; i < 3; i++)
+			_dimensions[i] = 10.0 * xdr::to_float(header + 16 + 4*(3*i+i));
+
+		if (natoms <= 9) {
+			// small systems are stored uncompressed
+			_data.resize(3*4*natoms);
+			if (fread (&_data[0], 1, _data.size(), _file) != _data.size()) {
+				_eof = true;
+				return;
+			}
+			for (int i = 0; i < 3*natoms; i++)
+				_coords[i] = 10.0 * xdr::to_float(&_data[4*i]);
+		}
+		else {
+			if (fread (header + HEADER_BYTES, 1, PACKING_BYTES, _file) != (size_t)PACKING_BYTES) {
+				_eof = true;
+				return;
+			}
+			const unsigned char * packing = header + HEADER_BYTES;
+			float precision = xdr::to_float(packing);
+			int minint[3], maxint[3];
+			for (int i = 0; i < 3; i++) {
+				minint[i] = xdr::to_int(packing + 4 + 4*i);
+				maxint[i] = xdr::to_int(packing + 16 + 4*i);
+			}
+			int smallidx = xdr::to_int(packing + 28);
+			int length = xdr::to_int(packing + 32);
+
+			// a few bytes of slack - the bit reader can look one byte past the packed data
+			_data.resize(xdr::padded(length) + 8);
+			if (fread (&_data[0], 1, xdr::padded(length), _file) != (size_t)xdr::padded(length)) {
+				_eof = true;
+				return;
+			}
+			this->_Decompress (natoms, minint, maxint, smallidx);
+
+			float inv_precision = 1.0 / precision;
+			for (int i = 0; i < 3*natoms; i++)
+				_coords[i] = 10.0 * (double)(_ints[i] * inv_precision);
+		}
+
+		++_frame;
+		return;
+	}
+
+	void XTCFile::_Decompress (const int num, const int minint[], const int maxint[], int smallidx) {
+
+		unsigned int sizeint[3], sizesmall[3];
+		int bitsizeint[3] = {0, 0, 0};
+		int bitsize;
+
+		for (int i = 0; i < 3; i++)
+			sizeint[i] = maxint[i] - minint[i] + 1;
+
+		// the sizes are too big to be packed together, so each is stored separately
+		if ((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff) {
+			for (int i = 0; i < 3; i++)
+				bitsizeint[i] = sizeofint(sizeint[i]);
+			bitsize = 0;
+		}
+		else
+			bitsize = sizeofints(3, sizeint);
+
+		if (smallidx < FIRSTIDX || smallidx >= LASTIDX) {
+			printf ("XTCFile::_Decompress() - bad compression parameters in frame %d of %s\n", _frame, _path.c_str());
+			exit(1);
+		}
+
+		int smaller = magicints[(FIRSTIDX > smallidx - 1) ? FIRSTIDX : smallidx - 1] / 2;
+		int smallnum = magicints[smallidx] / 2;
+		sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+
+		BitReader bits (&_data[0]);
+		int * out = &_ints[0];
+		int thiscoord[3], prevcoord[3];
+		int run = 0;
+		int i = 0;
+		while (i < num) {
+			if (bitsize == 0) {
+				for (int k = 0; k < 3; k++)
+					thiscoord[k] = bits.Bits(bitsizeint[k]);
+			}
+			else
+				bits.Ints (3, bitsize, sizeint, thiscoord);
+			i++;
+
+			for (int k = 0; k < 3; k++) {
+				thiscoord[k] += minint[k];
+				prevcoord[k] = thiscoord[k];
+			}
+
+			int is_smaller = 0;
+			if (bits.Bits(1)) {
+				run = bits.Bits(5);
+				is_smaller = run % 3;
+				run -= is_smaller;
+				is_smaller--;
+			}
+
+			if (run > 0) {
+				if (i + run/3 > num) {
+					printf ("XTCFile::_Decompress() - frame %d of %s holds more atoms than it should\n", _frame, _path.c_str());
+					exit(1);
+				}
+				for (int k = 0; k < run; k += 3) {
+					bits.Ints (3, smallidx, sizesmall, thiscoord);
+					i++;
+					for (int d = 0; d < 3; d++)
+						thiscoord[d] += prevcoord[d] - smallnum;
+
+					if (k == 0) {
+						// the first two atoms of a run are swapped (it packs waters better), so the earlier atom is written out second
+						for (int d = 0; d < 3; d++)
+							std::swap (thiscoord[d], prevcoord[d]);
+						*out++ = prevcoord[0]; *out++ = prevcoord[1]; *out++ = prevcoord[2];
+					}
+					else {
+						prevcoord[0] = thiscoord[0]; prevcoord[1] = thiscoord[1]; prevcoord[2] = thiscoord[2];
+					}
+					*out++ = thiscoord[0]; *out++ = thiscoord[1]; *out++ = thiscoord[2];
+				}
+			}
+			else {
+				*out++ = thiscoord[0]; *out++ = thiscoord[1]; *out++ = thiscoord[2];
+			}
+
+			smallidx += is_smaller;
+			if (is_smaller < 0) {
+				smallnum = smaller;
+				smaller = (smallidx > FIRSTIDX) ? magicints[smallidx - 1] / 2 : 0;
+			}
+			else if (is_smaller > 0) {
+				smaller = smallnum;
+				smallnum = magicints[smallidx] / 2;
+			}
+			sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+		}
+
+		return;
+	}
+
+}	// namespace gromacs
@@ -0,0 +1,40 @@
+#ifndef XTCFILE_H_
+#define XTCFILE_H_
+
+#include "mdsystem.h"
+#include "xdr.h"
+
+// Class for reading compressed GROMACS trajectories (.xtc)
+
+namespace gromacs {
+
+	/* The xtc format stores each frame's positions as integers (the positions scaled by a given precision) packed with a variable-length bit encoding, so frames differ in size. The frames are indexed by skipping through the file once when it is opened. Positions are converted from nm to angstroms. */
+	class XTCFile : public md_system::CoordinateFile {
+
+		public:
+
+			XTCFile (const std::string path);
+			virtual ~XTCFile () { }
+
+			void LoadNext ();
+
+			int Step () const { return _step; }
+			float Time () const { return _time; }
+
+			static const int MAGIC = 1995;
+
+		protected:
+			int				_step;
+			float			_time;
+
+			std::vector<unsigned char>	_data;		// the packed positions of a frame
+			std::vector<int>						_ints;		// the unpacked integer positions
+
+			// finds where each frame starts in the file
+			void _IndexXTCFrames ();
+			// unpacks the integer positions of num atoms from the frame data
+			void _Decompress (const int num, const int minint[], const int maxint[], int smallidx);
+	};
+
+}	// namespace gromacs
+#endif
@@ -8,14 +8,27 @@ namespace md_files {
 	XYZFile::XYZFile (std::string path) 
 		: 
 			md_system::CoordinateFile (path),
-			_initialized(false) {
+			_initialized(false),
+			_map((char *)NULL), _map_size(0),
+			_arcade((ArcadeReader *)NULL),
+			_text((XYZTextReader *)NULL) {
 
-				_file = fopen (path.c_str(), "rb");
-				if (_file == (FILE *)NULL) {
-					printf ("Couldn't load the XYZ coordinate file file:: %s\n", path.c_str());
+				// the file itself is opened (and decompressed, if need be) by CoordinateFile. Containers and text files are read straight off the disk, though, so they can't be compressed
+				const bool container = arcade::IsArcadeFile (path);
+				if (_gzip != (GzipFile *)NULL && (container || XYZTextReader::IsTextFile (path))) {
+					printf ("XYZFile - %s is a compressed %s file. Only binary xyz files can be read compressed - decompress it first\n", path.c_str(), container ? "arcade" : "text xyz");
 					exit(1);
 				}
 
+				if (container)
+					this->_OpenArcade();
+				else if (XYZTextReader::IsTextFile (path))
+					this->_OpenText();
+				else {
+					this->_MapFile();
+					this->_ReadHeader();
+				}
+
 				// Initialize the atoms
 				//this->LoadNext();
 			}
@@ -23,6 +36,99 @@ namespace md_files {
 	XYZFile::~XYZFile () {
 		for (Atom_it it = _atoms.begin(); it != _atoms.end(); it++)
 			delete *it;
+		if (_map != (char *)NULL)
+			munmap (_map, _map_size);
+		delete _arcade;
+		delete _text;
+	}
+
+	// the atom names come from the container's header, and its reader takes care of the frames
+	void XYZFile::_OpenArcade () {
+		_arcade = new ArcadeReader (this->_path, arcade::COORDINATES);
+		this->_size = _arcade->size();
+		this->_coords.resize(3*_size, 0.0);
+
+		for (int i = 0; i < this->_size; i++) {
+			AtomPtr new_atom = new Atom (_arcade->AtomNames()[i], &(this->_coords[3*i]));
+			_atoms.push_back (new_atom);
+			new_atom->ID(i);
+			new_atom->SetAtomProperties();
+		}
+
+		_num_frames = _arcade->NumFrames();
+		_initialized = true;
+		return;
+	}
+
+	// text files are indexed and parsed by their reader, and each frame's header line fills in the energy and timestep
+	void XYZFile::_OpenText () {
+		_text = new XYZTextReader (this->_path);
+		this->_size = _text->size();
+		this->_coords.resize(3*_size, 0.0);
+
+		for (int i = 0; i < this->_size; i++) {
+			AtomPtr new_atom = new Atom (_text->AtomNames()[i], &(this->_coords[3*i]));
+			_atoms.push_back (new_atom);
+			new_atom->ID(i);
+			new_atom->SetAtomProperties();
+		}
+
+		_num_frames = _text->NumFrames();
+		_initialized = true;
+		return;
+	}
+
+	// maps the whole file into memory. If that can't be done the frames are read in with fread instead
+	void XYZFile::_MapFile () {
+		struct stat st;
+		if (fstat (fileno(_file), &st) || !S_ISREG(st.st_mode) || st.st_size == 0) return;
+
+		void * map = mmap (NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(_file), 0);
+		if (map == MAP_FAILED) return;
+
+		_map = (char *)map;
+		_map_size = (size_t)st.st_size;
+		// the frames are read through from front to back
+		madvise (_map, _map_size, MADV_SEQUENTIAL);
+		return;
+	}
+
+	void XYZFile::_LoadMappedFrame () {
+		// the frame to load is the number of frames loaded so far
+		if (_frame >= _num_frames) {
+			_eof = true;
+			return;
+		}
+
+		const char * frame = _map + _header_bytes + (size_t)_frame * _frame_bytes;
+
+		// while selecting, the atoms stay on the coordinate array and only the pages holding the selected atoms get touched
+		if (!_selection.empty()) {
+			_full_frame = this->_RefreshFrame(_frame);
+			if (_full_frame)
+				memcpy (&_coords[0], frame, _frame_bytes);
+			else {
+				for (std::vector<run_t>::const_iterator it = _runs.begin(); it != _runs.end(); it++)
+					memcpy ((char *)&_coords[0] + it->offset, frame + it->offset, it->bytes);
+			}
+			_frame++;
+			return;
+		}
+
+		double * coords = (double *)frame;
+		for (int i = 0; i < this->_size; i++)
+			_atoms[i]->MapPosition (coords + 3*i);
+
+		// start paging in the next frame while this one is processed
+		if (_frame+1 < _num_frames) {
+			size_t page = (size_t)sysconf(_SC_PAGESIZE);
+			size_t next = _header_bytes + (size_t)(_frame+1) * _frame_bytes;
+			size_t start = next - next % page;
+			madvise (_map + start, std::min((size_t)_frame_bytes + next - start, _map_size - start), MADV_WILLNEED);
+		}
+
+		_frame++;
+		return;
 	}
 
 	void XYZFile::LoadNext () {
@@ -41,36 +147,61 @@ namespace md_files {
 		//char name[10];
 
 		// if we haven't already done so, let's clear out the previous atoms and resize things
-		if (!_initialized) {
-			rewind (this->_file);
-			fread (&(this->_size), sizeof(unsigned int), 1, this->_file);
+		if (!_initialized)
+			this->_ReadHeader();
+
+		if (_map != (char *)NULL) {
+			this->_LoadMappedFrame ();
+			return;
+		}
 
-			for (Atom_it it = _atoms.begin(); it != _atoms.end(); it++) {
-				delete *it;
+		if (_arcade != (ArcadeReader *)NULL) {
+			if (_frame >= _num_frames) {
+				_eof = true;
+				return;
 			}
-			_atoms.clear();
-			this->_coords.resize(3*_size, 0.0);
-
-			char name[5];
-			unsigned int len;
-			for (int i = 0; i < this->_size; i++) {
-				fread (&len, sizeof(unsigned int), 1, this->_file);
-				fread (name, sizeof(char), len+1, this->_file);
-				AtomPtr new_atom = new Atom (std::string(name), &(this->_coords[3*i]));
-				_atoms.push_back (new_atom); 
-				new_atom->ID(i);
-				new_atom->SetAtomProperties();
+			_arcade->LoadFrame (_frame, &(this->_coords[0]), _dimensions);
+			_frame++;
+			return;
+		}
+
+		if (_text != (XYZTextReader *)NULL) {
+			if (_frame >= _num_frames) {
+				_eof = true;
+				return;
 			}
-			_initialized = true;
+			_text->LoadFrame (_frame, &(this->_coords[0]));
+			this->ParseXYZHeader (_text->Header (_frame));
+			_frame++;
+			return;
 		}
 
-		for (int i = 0; i < this->_size; i++) {
-			fread (&(this->_coords[3*i]), sizeof(double), 3, this->_file);
-			//fread (&_coords[0], sizeof(double), 3*this->_size, _file);
-			// set the position of each atom for the timestep
-			//this->_coords[3*i] = pos[0];
-			//this->_coords[3*i+1] = pos[1];
-			//this->_coords[3*i+2] = pos[2];
+		if (this->_Prefetching()) {
+			// the atoms work straight out of the reader's buffer until the next frame is loaded
+			double * coords = (double *)this->_NextFrameBuffer();
+			if (coords == (double *)NULL) {
+				_eof = true;
+				return;
+			}
+			for (int i = 0; i < this->_size; i++)
+				_atoms[i]->MapPosition (coords + 3*i);
+			_frame++;
+			return;
+		}
+
+		if (!_selection.empty()) {
+			if (!this->_ReadFrame ((char *)&(this->_coords[0]), _frame)) {
+				_eof = true;
+				return;
+			}
+			_frame++;
+			return;
+		}
+
+		// a short read means the trajectory has run out (compressed files aren't always indexed, so this is where their end is found)
+		if (fread (&(this->_coords[0]), sizeof(double), 3*this->_size, this->_file) != (size_t)(3*this->_size)) {
+			_eof = true;
+			return;
 		}
 
 		_frame++;
@@ -78,10 +209,107 @@ namespace md_files {
 		return;
 	}	// load next
 
+	void XYZFile::_ReadHeader () {
+		rewind (this->_file);
+		fread (&(this->_size), sizeof(unsigned int), 1, this->_file);
+
+		for (Atom_it it = _atoms.begin(); it != _atoms.end(); it++) {
+			delete *it;
+		}
+		_atoms.clear();
+		this->_coords.resize(3*_size, 0.0);
+
+		char name[16];
+		unsigned int len;
+		for (int i = 0; i < this->_size; i++) {
+			if (fread (&len, sizeof(unsigned int), 1, this->_file) != 1 || len >= sizeof(name) || fread (name, sizeof(char), len+1, this->_file) != len+1) {
+				printf ("XYZFile::_ReadHeader() - couldn't read the name of atom %d from %s. Is it a binary xyz file?\n", i, _path.c_str());
+				exit(1);
+			}
+			name[len] = '\0';
+			AtomPtr new_atom = new Atom (std::string(name), &(this->_coords[3*i]));
+			_atoms.push_back (new_atom); 
+			new_atom->ID(i);
+			new_atom->SetAtomProperties();
+		}
+
+		// the frames are written one after the other right after the header
+		this->_IndexFrames (ftello64(this->_file), 3 * sizeof(double) * this->_size);
+		_initialized = true;
+		return;
+	}
+
+	// an unindexed (plain gzip) file can still be rewound to its first frame
+	void XYZFile::Seek (const int frame) {
+		if (frame < 0 || (frame >= _num_frames && !(_num_frames < 0 && frame == 0))) {
+			printf ("XYZFile::Seek() - frame %d is out of range. The file %s has %d frames\n", frame, _path.c_str(), _num_frames);
+			exit(1);
+		}
+
+		if (_map == (char *)NULL && _arcade == (ArcadeReader *)NULL && _text == (XYZTextReader *)NULL)
+			this->_PositionFile (_header_bytes + (long long)frame * _frame_bytes);
+
+		this->_frame = frame;
+		this->_eof = false;
+		this->LoadNext();
+		this->_frame = frame+1;
+		return;
+	}
+
+	// Reading ahead is done with a reader thread rather than through the memory map, so the file is unmapped first. The current frame is copied out of the map, and the file picks up at the frame after it.
+	void XYZFile::Prefetch (const int depth) {
+		if (depth < 1) return;
+
+		// containers are read ahead a chunk at a time by their own decoder
+		if (_arcade != (ArcadeReader *)NULL) {
+			_arcade->Prefetch (true);
+			return;
+		}
+		// and text files are parsed a chunk of frames at a time (see TextThreads)
+		if (_text != (XYZTextReader *)NULL)
+			return;
+
+		if (_map != (char *)NULL) {
+			this->_UnmapAtoms();
+			munmap (_map, _map_size);
+			_map = (char *)NULL;
+			_map_size = 0;
+			fseeko64 (this->_file, _header_bytes + (long long)_frame * _frame_bytes, SEEK_SET);
+		}
+
+		CoordinateFile::Prefetch (depth);
+		return;
+	}
+
+	void XYZFile::_UnmapAtoms () {
+		for (int i = 0; i < this->_size; i++) {
+			_coords[3*i] = _atoms[i]->X();
+			_coords[3*i+1] = _atoms[i]->Y();
+			_coords[3*i+2] = _atoms[i]->Z();
+			_atoms[i]->MapPosition (&_coords[3*i]);
+		}
+		return;
+	}
+
+	// The atoms of a mapped or read-ahead frame point into the map or the read-ahead ring, so they're moved back onto the coordinate array where the selected positions get written
+	void XYZFile::Select (const std::vector<int>& indices, const int refresh) {
+		if (_arcade != (ArcadeReader *)NULL || _text != (XYZTextReader *)NULL) {
+			CoordinateFile::Select (indices, refresh);
+			return;
+		}
+
+		const bool prefetching = this->_Prefetching();
+		if (!this->_SelectAtoms (indices, refresh)) return;
+		if (prefetching || (_map != (char *)NULL && !_selection.empty()))
+			this->_UnmapAtoms();
+		// readahead of the map would page in the whole of each frame
+		if (_map != (char *)NULL)
+			madvise (_map, _map_size, (_selection.empty()) ? MADV_SEQUENTIAL : MADV_RANDOM);
+		return;
+	}
+
 	void XYZFile::Rewind () {
-		rewind(this->_file);
-		LoadNext();
-		this->_frame = 1;
+		this->Seek (0);
 	} // rewind
 
 	void XYZFile::WriteXYZ (Atom_ptr_vec& atoms) {
@@ -99,6 +327,7 @@ namespace md_files {
 		//std::cout << header << std::endl;
 		boost::erase_all(header, " ");
 		boost::erase_all(header, "\n");
+		boost::erase_all(header, "\r");
 		//std::cout << header << std::endl;
 		std::vector<std::string> strs;
 		// split the header - comma delimited
@@ -108,6 +337,7 @@ namespace md_files {
 		for (std::vector<std::string>::iterator it = strs.begin(); it != strs.end(); it++) {
 			tokens.clear();
 			boost::split(tokens, *it, boost::is_any_of("="));
+			if (tokens.size() < 2) continue;
 
 			// parse the possible tokens
 			if (tokens[0] == "E") {
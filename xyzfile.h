@@ -2,8 +2,14 @@
 #define XYZFILE_H_
 
 #include "mdsystem.h"
+#include "arcadefile.h"
+#include "xyztext.h"
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
 
 namespace md_files {
 
@@ -22,6 +28,18 @@ namespace md_files {
 			// see LoadFirst for the init arg
 			void LoadNext ();
 			void Rewind ();
+			void Seek (const int frame);
+			void Prefetch (const int depth);
+			// binary files (mapped or not) can read just the selected atoms of each frame
+			void Select (const std::vector<int>& indices, const int refresh = 0);
+			// number of threads used to parse a text xyz file
+			void TextThreads (const int num) { if (_text != (XYZTextReader *)NULL) _text->Threads(num); }
+
+			// an arcade container stores the box of each frame. Containers written without a box store zeros
+			bool HasBox () const { return _arcade != (ArcadeReader *)NULL && _dimensions[0] > 0.0; }
+			// ...and the molecular topology of the system, when it was written with one
+			bool HasTopology () const { return _arcade != (ArcadeReader *)NULL && !_arcade->Topology().empty(); }
+			const arcade::topology_vec& Topology () const { return _arcade->Topology(); }
 
 
 			// output functions
@@ -41,6 +59,24 @@ namespace md_files {
 			Atom_ptr_vec  _atoms;		// The listing of the atoms in the file
 			bool _initialized;				// To tell wether or not a file has been loaded
 
+			// The file is memory-mapped when possible, and the atom positions point straight into each frame's coordinate block. The mapping is private, so changes to the positions never make it back to the file.
+			char *	_map;
+			size_t	_map_size;
+
+			void _MapFile ();
+			void _LoadMappedFrame ();
+			// copies the current positions into the coordinate array, and points the atoms back at it
+			void _UnmapAtoms ();
+
+			// The coordinates can also come from an arcade container, in which case the frames are decoded by the reader
+			ArcadeReader *	_arcade;
+			void _OpenArcade ();
+			// ...or be parsed straight out of a text xyz file
+			XYZTextReader *	_text;
+			void _OpenText ();
+			// reads in the atom names from the file header, and indexes the frames that follow
+			void _ReadHeader ();
+
 			void ParseXYZHeader (std::string);
 	};	 // class xyzfile
 
@@ -4,11 +4,18 @@ namespace md_files {
 
 	using namespace md_system;
 
+	// wannier centers within this distance of an atom belong to it
+	const double WANNIER_CUTOFF = 1.0;
+	// the atom that a water's (or hydroxide's, or hydronium's) wanniers are gathered around
+	const AtomName oxygen ("O");
+
 	XYZSystem::XYZSystem (const std::string& filepath, const VecR& size, const std::string& wannierpath) :
 		_xyzfile(filepath),
 		_wanniers(wannierpath),
 		_reparse_limit(1),	// initially set to parse everything everytime
-		_reparse_step(0)
+		_reparse_step(0),
+		_incremental(false),
+		_slab_axis(-1)
 	{
 		MDSystem::Dimensions (size);
 		//this->LoadNext();
@@ -22,21 +29,36 @@ namespace md_files {
 
 
 
+	// the interatomic distances and bonding information - atomic bonding graph - are needed every frame, whether or not the molecules are reparsed
+	void XYZSystem::_UpdateGraph () {
+		try { graph.UpdateGraph (_xyzfile.Atoms()); }
+
+		catch (bondgraph::BondGraph::graphex& ex) {
+			std::cout << "Caught an exception while updating the bond graph" << std::endl;
+		}
+		return;
+	}
+
 	void XYZSystem::_ParseMolecules () {
 
 		/***********************************************************************************
 		 * This is the top-level parsing routine to give the overall idea of what's going on
+		 * The bond graph has to be up to date for the frame (see _UpdateGraph)
 		 * *********************************************************************************/
-		// first things first - we need the interatomic distances and bonding information - atomic bonding graph
-		try { graph.UpdateGraph (_xyzfile.Atoms()); }
-
-		catch (bondgraph::BondGraph::graphex& ex) {
-			std::cout << "Caught an exception while updating the bond graph" << std::endl;
+		// once the molecules have been found, the incremental mode only has to deal with the ones that changed
+		if (_incremental && !_mols.empty()) {
+			this->_ReparseChangedMolecules();
 		}
+		else {
+			this->_InitializeSystemAtoms();
 
-		this->_InitializeSystemAtoms();
+			this->_FindMolecules();
 
-		this->_FindMolecules();
+			if (_incremental) {
+				graph.BondPairs (_covalent_bonds, bondgraph::covalent);
+				this->_IndexMolecules();
+			}
+		}
 
 		/*
 			 this->_ParseSimpleMolecule<Hydronium> (Atom::O, Atom::H, 3);
@@ -67,31 +89,177 @@ namespace md_files {
 
 
 	void XYZSystem::FindMoleculesByMoleculeGraph () {
-		// track which atoms have already been parsed in the system
+		// now do the work of parsing out the molecules. The covalently bound groups of atoms are found in a single union-find pass over the bond graph, and numbered in the order of their first atom.
+		// For each group we tease out the type of molecule it is from its element counts, then we set the molid and add it to the list of molecules.
+		int num_mols = this->_FindCovalentGroups();
+
+		for (int c = 0; c < num_mols; c++) {
+			MolPtr newmol = this->_NewMolecule (c);
+			newmol->MolID((int)_mols.size());
+			newmol->FixAtoms();
+			_mols.push_back(newmol);
+		}
+
+		// every atom has been placed into a group
 		_unparsed.clear();
-		std::copy (_xyzfile.begin(), _xyzfile.end(), std::back_inserter(_unparsed));
+	}	// find molecules by molecule graph
 
-		// now do the work of parsing out the molecules. The idea is to grab sub-graphs of the atomic bondgraph that was built that represent covalently bound atom groups.
-		// For each subgraph we tease out the type of molecule it is, then we set the molid and add it to the list of molecules.
-		std::vector<AtomPtr> parsed;
-		while (!_unparsed.empty()) {
-			// build the molecule graph of whatever is at the front of the unparsed list
-			molgraph::MoleculeGraph molgraph;
-			molgraph.Initialize(_unparsed.front(), graph);
+	int XYZSystem::_FindCovalentGroups () {
+		int num_groups = graph.Components (_components, bondgraph::covalent);
+		int num_atoms = (int)_components.size();
+
+		_first_atoms.assign(num_groups, -1);
+		_signatures.assign(num_groups, molgraph::ElementSignature());
+		for (int i = 0; i < num_atoms; i++) {
+			int c = _components[i];
+			if (_first_atoms[c] < 0)
+				_first_atoms[c] = i;
+			_signatures[c].Add(_xyzfile[i]->Element());
+		}
 
-			// then generate the molecule from the molecule graph
-			MolPtr newmol = molgraph::MoleculeGraph2Molecule (molgraph);
+		_visited.assign(num_atoms, 0);
+		return num_groups;
+	}
 
-			parsed = molgraph.Atoms();
-			this->_UpdateUnparsedList (parsed);
+	MolPtr XYZSystem::_NewMolecule (const int group) {
+		this->_CollectMoleculeAtoms (_first_atoms[group], _mol_atoms);
 
-			newmol->MolID((int)_mols.size());
+		// generate the molecule from the group's atoms
+		MolPtr newmol = molgraph::Signature2Molecule (_mol_atoms, _signatures[group], &_pool);
+		if (newmol == (MolPtr)NULL) {
+			this->_MoleculeIdentificationError (_mol_atoms);
+		}
+		return newmol;
+	}
+
+	void XYZSystem::_IndexMolecules () {
+		_free_ids.clear();
+		int max_id = -1;
+		for (Mol_it it = _mols.begin(); it != _mols.end(); it++)
+			if ((*it)->MolID() > max_id) max_id = (*it)->MolID();
+		_mol_slots.assign (max_id+1, -1);
+		for (int i = 0; i < (int)_mols.size(); i++)
+			_mol_slots[_mols[i]->MolID()] = i;
+		return;
+	}
+
+	// Only the covalently-bound groups that gained or lost a covalent bond need to be reparsed - all the other groups are made of the same atoms as before, and so their molecules are kept.
+	void XYZSystem::_ReparseChangedMolecules () {
+		// find the covalent bonds that were formed or broken since the last parse (the bond lists are sorted)
+		graph.BondPairs (_new_bonds, bondgraph::covalent);
+		_changed_bonds.clear();
+		std::set_symmetric_difference (_covalent_bonds.begin(), _covalent_bonds.end(), _new_bonds.begin(), _new_bonds.end(), std::back_inserter(_changed_bonds));
+		_covalent_bonds.swap(_new_bonds);
+
+		if (_changed_bonds.empty()) return;
+
+		// mark the groups that hold the atoms of the changed bonds
+		int num_groups = this->_FindCovalentGroups();
+		_rebuild.assign(num_groups, 0);
+		for (bond_pair_vec::const_iterator it = _changed_bonds.begin(); it != _changed_bonds.end(); it++) {
+			_rebuild[_components[it->first]] = 1;
+			_rebuild[_components[it->second]] = 1;
+		}
+
+		// then remove the old molecules of every atom in those groups - their places in the list are left empty for now
+		for (int i = 0; i < (int)_components.size(); i++) {
+			if (!_rebuild[_components[i]]) continue;
+
+			MolPtr mol = _xyzfile[i]->ParentMolecule();
+			if (mol == (MolPtr)NULL) continue;
+
+			for (Atom_it it = mol->begin(); it != mol->end(); it++) {
+				(*it)->ParentMolecule ( (MolPtr)NULL );
+				(*it)->Residue ("");
+				(*it)->MolID (-1);
+			}
+			_free_ids.push_back (mol->MolID());
+			_mols[_mol_slots[mol->MolID()]] = (MolPtr)NULL;
+			_mol_slots[mol->MolID()] = -1;
+			_pool.Release (mol);
+		}
+		std::sort (_free_ids.begin(), _free_ids.end());
+
+		// the new molecules take over the IDs that were freed up (lowest first) and the empty places in the list - the molecules that were kept are left alone
+		unsigned int next = 0;
+		int slot = 0;
+		for (int c = 0; c < num_groups; c++) {
+			if (!_rebuild[c]) continue;
+
+			MolPtr newmol = this->_NewMolecule (c);
+			if (next < _free_ids.size())
+				newmol->MolID(_free_ids[next++]);
+			else {
+				newmol->MolID((int)_mol_slots.size());
+				_mol_slots.push_back(-1);
+			}
+
+			while (slot < (int)_mols.size() && _mols[slot] != (MolPtr)NULL)
+				++slot;
+			if (slot < (int)_mols.size())
+				_mols[slot] = newmol;
+			else
+				_mols.push_back(newmol);
+			_mol_slots[newmol->MolID()] = slot;
 			newmol->FixAtoms();
-			_mols.push_back(newmol);
+		}
+		// IDs not taken this time stay free for later
+		_free_ids.erase (_free_ids.begin(), _free_ids.begin() + next);
+
+		// if there are fewer molecules than before, the places left empty are closed up. The molecules keep their IDs, and only move down the list
+		if (std::find (_mols.begin(), _mols.end(), (MolPtr)NULL) != _mols.end()) {
+			_mols.erase (std::remove (_mols.begin(), _mols.end(), (MolPtr)NULL), _mols.end());
+			for (int i = 0; i < (int)_mols.size(); i++)
+				_mol_slots[_mols[i]->MolID()] = i;
+		}
 
-			//newmol->SetAtoms();
+		return;
+	}	// reparse changed molecules
+
+	// The atoms are gathered in the same order that a molecule graph would have been built from the first atom: all the new atoms bound to an atom are taken, and then each of those is followed in turn.
+	void XYZSystem::_CollectMoleculeAtoms (const int first, Atom_ptr_vec& atoms) {
+		atoms.clear();
+		_stack.clear();
+
+		_visited[first] = 1;
+		atoms.push_back (_xyzfile[first]);
+		_stack.push_back (first);
+
+		while (!_stack.empty()) {
+			int v = _stack.back();
+			_stack.pop_back();
+
+			int top = (int)_stack.size();
+			bondgraph::BondGraph::Bond_range bonds = graph.VertexBonds(v);
+			for (bondgraph::BondGraph::Bond_it it = bonds.first; it != bonds.second; it++) {
+				if (it->btype != bondgraph::covalent || _visited[it->vertex]) continue;
+				_visited[it->vertex] = 1;
+				atoms.push_back (it->atom);
+				_stack.push_back (it->vertex);
+			}
+			// the first of the new atoms has to be followed first
+			std::reverse (_stack.begin() + top, _stack.end());
 		}
-	}	// find molecules by molecule graph
+
+		return;
+	}
+
+	void XYZSystem::_MoleculeIdentificationError (const Atom_ptr_vec& atoms) const {
+		std::cerr << "XYZSystem :: Couldn't figure out the molecule formed by the following atoms:" << std::endl;
+		printf ("\n");
+		for (Atom_it atom = atoms.begin(); atom != atoms.end(); atom++) {
+			// print the atom
+			printf ("%s(%d)", (*atom)->Name().c_str(), (*atom)->ID());
+
+			// then print all the atoms it's attached to
+			Atom_ptr_vec bonded = graph.BondedAtoms (*atom, bondgraph::covalent);
+			for (Atom_it it = bonded.begin(); it != bonded.end(); it++) {
+				printf (" -%.2f-> %s(%d)", graph.Distance(*atom, *it), (*it)->Name().c_str(), (*it)->ID());
+			}
+			printf ("\n");
+		}
+		exit(1);
+	}
 
 
 
@@ -193,15 +361,17 @@ void XYZSystem::_CheckForUnparsedAtoms () const {
  *
  * What we'll do here is run through each of the wannier centers and find which molecule they belong to. For each center we'll check its distance against all the atoms and when we find the one it's bound to we'll shove it into the parent molecule.
  * ****************************/
-void XYZSystem::_ParseWanniers () {
+void XYZSystem::_ParseWanniers (const Mol_ptr_vec& mols) {
 	// we've got to clear out all the wanniers already loaded into the molecules
 	std::for_each (_mols.begin(), _mols.end(), std::mem_fun(&Molecule::ClearWanniers));
 	//std::for_each (_mols.begin(), _mols.end(), std::mem_fun(&Molecule::SetAtoms));
 
+	this->_BinWanniers();
+
 	int num;
 	std::map<Molecule::Molecule_t, int>::iterator mapend = WannierFile::numWanniers.end();
 	std::map<Molecule::Molecule_t, int>::iterator it;
-	for (Mol_it mol = _mols.begin(); mol != _mols.end(); mol++) {
+	for (Mol_it mol = mols.begin(); mol != mols.end(); mol++) {
 
 		it = WannierFile::numWanniers.find((*mol)->MolType());
 
@@ -272,13 +442,42 @@ parsed_ws.push_back (*wi);
 return;
 }	// Parse Wanniers
 
+void XYZSystem::_BinWanniers () {
+	_wannier_grid.Reset (MDSystem::Dimensions(), WANNIER_CUTOFF, (int)_wanniers.size());
+	if (!_wannier_grid.Usable()) return;
+
+	int i = 0;
+	for (vector_map_it it = _wanniers.begin(); it != _wanniers.end(); it++, i++)
+		_wannier_grid.Insert (i, *it);
+}
+
 void XYZSystem::AddWanniersToAtom (MolPtr mol, AtomPtr atom, unsigned int num) {
+
+	if (_wannier_grid.Usable()) {
+		// gather up the centers close to the atom from the surrounding cells. They're sorted back into file order so that the atom picks up the same centers as it would by scanning the whole file
+		_near_wanniers.clear();
+		int neighbor_cells[27];
+		_wannier_grid.Neighbors (_wannier_grid.Cell(atom->Position()), neighbor_cells);
+		for (int c = 0; c < 27; c++) {
+			for (int i = _wannier_grid.Head(neighbor_cells[c]); i != CellGrid::END; i = _wannier_grid.Next(i)) {
+				if (MDSystem::Distance(atom->Position(), _wanniers[i]).norm() < WANNIER_CUTOFF)
+					_near_wanniers.push_back(i);
+			}
+		}
+		std::sort (_near_wanniers.begin(), _near_wanniers.end());
+
+		for (std::vector<int>::const_iterator it = _near_wanniers.begin(); it != _near_wanniers.end() && num; it++, num--)
+			mol->AddWannier(_wanniers[*it]);
+		return;
+	}
+
+	// the box is too small to bin the centers, so check all of them
 	//printf ("<------------new atom!!--------------->\n");
 	for (vector_map_it it = _wanniers.begin(); it != _wanniers.end(); it++){
 		double distance = MDSystem::Distance(atom->Position(), *it).norm();
 		//printf ("distance = %f\n", distance);
 		//it->Print();
-		if (distance < 1.0) {
+		if (distance < WANNIER_CUTOFF) {
 			//printf ("----grabbed one!----\n");
 			mol->AddWannier(*it);
 			if (--num == 0)
@@ -302,7 +501,7 @@ void XYZSystem::AddWanniers (MolPtr mol, const int num) {
 		AddWanniersToAtom (mal, mal->CM(), 4);
 	}
 	else if (mol->MolType() == Molecule::H2O || mol->MolType() == Molecule::OH || mol->MolType() == Molecule::H3O)
-		AddWanniersToAtom (mol, mol->GetAtom("O"), 4);
+		AddWanniersToAtom (mol, mol->GetAtom(oxygen), 4);
 	// sort all the wannier centers by their distance to the given reference location
 	//else {
 		//std::sort (_wanniers.begin(), _wanniers.end(), vecr_distance_cmp(mol->ReferencePoint()));
@@ -313,25 +512,79 @@ void XYZSystem::AddWanniers (MolPtr mol, const int num) {
 	//}
 }
 
+// the whole frame is read after rewinding or seeking, and the slab (if any) picked from it
 void XYZSystem::Rewind () {
+	if (_slab_axis >= 0)
+		_xyzfile.Select (std::vector<int>());
 	_xyzfile.Rewind();
 	this->LoadNext();
 }	// rewind
 
+void XYZSystem::Seek (const int frame) {
+	Molecule::NextFrame();
+	if (_slab_axis >= 0)
+		_xyzfile.Select (std::vector<int>());
+	_xyzfile.Seek(frame);
+	if (_xyzfile.HasBox())
+		MDSystem::Dimensions (_xyzfile.Dimensions());
+	// a wannier file that has run out of frames is still indexed, and can be seeked back into
+	if (_wanniers.NumFrames() >= 0)
+		_wanniers.Seek(frame);
+
+	// the molecules of the last frame loaded may have nothing to do with the ones of the new frame
+	this->_UpdateGraph();
+	this->_ParseMolecules();
+	_reparse_step = 0;
+	if (_wanniers.Loaded())
+		this->_ParseWanniers(_mols);
+	if (_slab_axis >= 0)
+		this->_SelectSlabAtoms();
+}	// seek
+
+int XYZSystem::NumFrames () const {
+	int frames = _xyzfile.NumFrames();
+	if (_wanniers.NumFrames() >= 0 && _wanniers.NumFrames() < frames)
+		frames = _wanniers.NumFrames();
+	return frames;
+}
+
 
 void XYZSystem::LoadNext () {
+	Molecule::NextFrame();
 	_xyzfile.LoadNext();
+	// there's nothing new to parse past the end of the trajectory
+	if (_xyzfile.eof()) return;
+	// containers carry the box of every frame
+	if (_xyzfile.HasBox())
+		MDSystem::Dimensions (_xyzfile.Dimensions());
 
 	if (_wanniers.Loaded()) {
 		_wanniers.LoadNext();
 	}
+	// Only the slab's atoms are current on a frame that wasn't read in full, so the molecules are left as they were found on the last whole frame, and only the slab's molecules get wannier centers
+	if (!_xyzfile.FullFrame() && !_mols.empty()) {
+		if (_wanniers.Loaded())
+			this->_ParseWanniers(_slab_mols);
+		else
+			std::for_each (_mols.begin(), _mols.end(), std::mem_fun(&Molecule::ClearWanniers));
+		return;
+	}
+
+	// the molecules are only reparsed every _reparse_limit frames, but the bonds are found and the wannier centers reassigned every frame
 	//try {
-	//if (++_reparse_step == _reparse_limit) {
-	this->_ParseMolecules();
+	this->_UpdateGraph();
+	if (++_reparse_step >= _reparse_limit || _mols.empty()) {
+		this->_ParseMolecules();
+		_reparse_step = 0;
+	}
 	if (_wanniers.Loaded())
-		this->_ParseWanniers();
-	//_reparse_step = 0;
-	//}
+		this->_ParseWanniers(_mols);
+	// molecules carried over from the last frame would otherwise hang on to its centers
+	else
+		std::for_each (_mols.begin(), _mols.end(), std::mem_fun(&Molecule::ClearWanniers));
+	// the slab's molecules are picked anew whenever a whole frame has been read
+	if (_slab_axis >= 0 && !_xyzfile.eof())
+		this->_SelectSlabAtoms();
 	//} catch (xyzsysex& ex) {
 	//std::cout << "Exception caught while parsing the molecules of the XYZ system" << std::endl;
 	//throw;
@@ -341,6 +594,30 @@ void XYZSystem::LoadNext () {
 
 
 
+void XYZSystem::SelectSlab (const int axis, const double low, const double high, const int refresh) {
+	_slab_axis = axis;
+	_slab_low = low;
+	_slab_high = high;
+	_slab_refresh = refresh;
+	// the molecules of the frame already loaded are used - otherwise the slab is picked once the first frame is in
+	if (!_mols.empty())
+		this->_SelectSlabAtoms();
+	return;
+}
+
+void XYZSystem::_SelectSlabAtoms () {
+	const std::vector<int> atoms = MDSystem::SlabAtoms (_mols, _slab_axis, _slab_low, _slab_high);
+	// the atoms come a molecule at a time
+	_slab_mols.clear();
+	for (std::vector<int>::const_iterator it = atoms.begin(); it != atoms.end(); it++) {
+		MolPtr mol = _xyzfile[*it]->ParentMolecule();
+		if (_slab_mols.empty() || _slab_mols.back() != mol)
+			_slab_mols.push_back (mol);
+	}
+	_xyzfile.Select (atoms, _slab_refresh);
+	return;
+}
+
 // This will calculate the total dipole moment of the system based on atom locations and wannier center positions
 // The origin is shifted to the center of the system in order to get closest images (wrapped into the box) of all the atoms/wanniers
 VecR XYZSystem::SystemDipole () {
@@ -348,10 +625,28 @@ VecR XYZSystem::SystemDipole () {
 	VecR dipole;
 	dipole.Set(0.0,0.0,0.0);
 
-	for (Atom_it it = _xyzfile.begin(); it != _xyzfile.end(); it++) {
-		VecR ri = (*it)->Position();
-		dipole += ri * (*it)->Charge();
+	// on a frame that wasn't read in full only the slab's molecules are current (see SelectSlab)
+	if (!_xyzfile.FullFrame()) {
+		for (Mol_it mol = _slab_mols.begin(); mol != _slab_mols.end(); mol++) {
+			for (Atom_it atom = (*mol)->begin(); atom != (*mol)->end(); atom++)
+				dipole += (*atom)->Position() * (*atom)->Charge();
+			for (vector_map_it w = (*mol)->wanniers_begin(); w != (*mol)->wanniers_end(); w++)
+				dipole -= (*w) * 2.0;
+		}
+		return (dipole);
+	}
+
+	// the padding of the store has no charge, so it can be summed over with the atoms (in double precision, whatever the positions are kept in)
+	const AtomStore& store = this->Store();
+	const coord_real * px = store.X(), * py = store.Y(), * pz = store.Z();
+	const double * q = store.Charges();
+	double dx = 0.0, dy = 0.0, dz = 0.0;
+	for (int i = 0; i < store.Padded(); i++) {
+		dx += px[i] * q[i];
+		dy += py[i] * q[i];
+		dz += pz[i] * q[i];
 	}
+	dipole.Set (dx, dy, dz);
 
 	for (WannierFile::Wannier_it it = _wanniers.begin(); it != _wanniers.end(); it++) {
 		dipole -= (*it) * 2.0;
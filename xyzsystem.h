@@ -30,10 +30,24 @@ namespace md_files {
 			int _reparse_limit;					
 			int _reparse_step;
 
+			// With incremental reparsing, only the molecules whose covalent bonds have changed since the last parse are rebuilt. All the others (and their IDs) are kept as they are.
+			bool _incremental;
+			typedef std::vector<bondgraph::BondGraph::vertex_pair> bond_pair_vec;
+			bond_pair_vec			_covalent_bonds;		// covalent bonds of the last parse
+			bond_pair_vec			_new_bonds;
+			bond_pair_vec			_changed_bonds;
+			std::vector<char>	_rebuild;				// covalent groups that have to be reparsed
+			// Molecule IDs are kept stable across reparses, so they don't follow a molecule's place in _mols once molecules come and go
+			std::vector<int>	_mol_slots;		// place in _mols of each molecule ID (-1 for IDs not in use)
+			std::vector<int>	_free_ids;		// molecule IDs freed up by removed molecules
+			void _IndexMolecules ();				// sets up the ID map after a full parse
+			MoleculePool			_pool;				// old molecules kept around for the next parse rather than re-allocated
+
 			/* For debugging (and other useful things?) this will keep a list of all the atoms that have been processed into molecules. Any atoms left over at the end of the parsing routine are not included and ... can potentially cause problems */
 			Atom_ptr_vec _unparsed;
 
 			virtual void _ParseMolecules ();		// take the atoms we have and stick them into molecules - general umbrella routine
+			void _UpdateGraph ();							// finds the bonds of the current frame
 			virtual void _FindMolecules () { this->FindMoleculesByMoleculeGraph(); }
 
 			virtual void _InitializeSystemAtoms () { this->NullOutSystemAtoms (); }
@@ -43,11 +57,29 @@ namespace md_files {
 			// determine molecules by connectivity
 			void FindMoleculesByMoleculeGraph ();
 
+			// scratch space for finding the molecules
+			std::vector<int>	_components;		// the covalently-bound group (molecule) of each atom
+			std::vector<int>	_first_atoms;		// first atom of each group
+			std::vector<molgraph::ElementSignature>	_signatures;	// element counts of each group
+			std::vector<char>	_visited;
+			std::vector<int>	_stack;
+			Atom_ptr_vec			_mol_atoms;
+
+			// labels the covalently-bound groups of atoms, and finds the first atom and element counts of each. Returns the number of groups.
+			int _FindCovalentGroups ();
+			// creates the molecule formed by a covalently-bound group
+			MolPtr _NewMolecule (const int group);
+			// gathers the atoms of the covalently-bound group that the given atom belongs to
+			void _CollectMoleculeAtoms (const int first, Atom_ptr_vec& atoms);
+			// rebuilds only the molecules whose covalent bonds have changed
+			void _ReparseChangedMolecules ();
+			void _MoleculeIdentificationError (const Atom_ptr_vec& atoms) const;
+
 			void NullOutSystemAtoms () {
 
 				// Now let's do some house-cleaning to set us up for working with new molecules - these change a lot!
 				for (Mol_it it = _mols.begin(); it != _mols.end(); it++) {
-					delete *it;				// get rid of all the molecules in memory
+					_pool.Release (*it);		// hand the molecules back to the pool to be reused
 				}
 				_mols.clear();				// then clear out the molecule list
 
@@ -68,18 +100,31 @@ namespace md_files {
 
 			//void _ParseNitricAcids ();
 			//void _ParseProtons ();
-			void _ParseWanniers ();
+			// clears the wanniers of every molecule, and hands out the centers to the given ones
+			void _ParseWanniers (const Mol_ptr_vec& mols);
 			//void _ParseAlkanes ();
 			// given a list of wanniers, this will grab the nearest num wannier centers and add them into the molecule
 			void AddWanniers (MolPtr mol, const int num);
 			void AddWanniersToAtom (MolPtr mol, AtomPtr atom, unsigned int num);
 
+			// the wannier centers are binned once per frame so that each atom only has to check the centers in the cells around it
+			CellGrid					_wannier_grid;
+			std::vector<int>	_near_wanniers;		// wannier centers near the atom currently being processed
+			void _BinWanniers ();
+
 			void _UpdateUnparsedList (Atom_ptr_vec& parsed);	// fixes the list of unparsed atoms
 			bool _Unparsed (const AtomPtr atom) const;
 			void _CheckForUnparsedAtoms () const;
 
 			bondgraph::BondGraph graph;
 
+			// the slab of the system being loaded (see SelectSlab) - the axis is -1 when everything is loaded
+			int			_slab_axis;
+			double	_slab_low, _slab_high;
+			int			_slab_refresh;
+			Mol_ptr_vec	_slab_mols;		// the molecules whose atoms are being loaded
+			void _SelectSlabAtoms ();
+
 		public:
 			// constructors
 			XYZSystem (const std::string& filepath, const VecR& size, const std::string& wannierpath = "");
@@ -87,6 +132,26 @@ namespace md_files {
 
 
 			void SetReparseLimit (const int limit) { _reparse_limit = limit; }
+			// only reparse the molecules whose covalent bonds changed since the previous parse
+			void IncrementalReparse (const bool incremental) { _incremental = incremental; }
+			// reuse the bondgraph's neighbor lists between frames (see BondGraph::VerletSkin)
+			void VerletSkin (const double skin) { graph.VerletSkin(skin); }
+			// number of threads used to find the bonds each frame
+			void BondThreads (const int num) { graph.NumThreads(num); }
+			// reads up to depth frames of the trajectory (and wanniers) ahead in the background
+			void Prefetch (const int depth) {
+				_xyzfile.Prefetch(depth);
+				if (_wanniers.NumFrames() >= 0)
+					_wanniers.Prefetch(depth);
+			}
+			/* Only loads the atoms of the molecules that have an atom within [low, high] along the axis (binary xyz files only) - the other atoms keep the positions they had at the last frame read in full. Every refresh frames (if refresh > 0) the whole frame is read and the molecules in the slab are picked anew.
+				 The bonds and molecules are only found on the frames read in full, so in between the molecules stay as they were. The wannier centers are always read in full, but on the other frames they're only handed out to the slab's molecules, and the system dipole is summed over just those molecules. */
+			void SelectSlab (const int axis, const double low, const double high, const int refresh = 0);
+			// number of threads used to parse text xyz and wannier files (which are read without converting them first)
+			void TextThreads (const int num) {
+				_xyzfile.TextThreads(num);
+				_wanniers.TextThreads(num);
+			}
 
 			Atom_ptr_vec CovalentBonds (const AtomPtr atom) const { return graph.BondedAtoms(atom, bondgraph::covalent); }
 			Atom_ptr_vec BondedAtoms (const AtomPtr atom) const { return graph.BondedAtoms (atom); }
@@ -104,6 +169,9 @@ namespace md_files {
 			virtual void LoadNext ();
 			//! rewinds the coordinate files
 			virtual void Rewind ();
+			virtual void Seek (const int frame);
+			virtual int NumFrames () const;
+			virtual bool eof () const { return _xyzfile.eof(); }
 
 			//! The set of all molecules in a system
 			virtual Mol_ptr_vec& Molecules () { return _mols; }
@@ -154,9 +222,10 @@ namespace md_files {
 			void _FindMolecules ();
 
 		public:
+			// a container that carries its own topology is used instead of the topology file
 			TopologyXYZSystem (const std::string& filepath, const VecR& size, const std::string& wannierpath = "", const std::string& topologypath = "xyz.top") :
 				XYZSystem (filepath, size, wannierpath),
-				_topology(topologypath),
+				_topology(_xyzfile.HasTopology() ? MolecularTopologyFile(_xyzfile.Topology()) : MolecularTopologyFile(topologypath)),
 				_parsed (false) { }
 
 	}; // xyz topology system class
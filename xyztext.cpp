@@ -0,0 +1,314 @@
+#include "xyztext.h"
+
+namespace md_files {
+
+	static const double POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+	// the most digits that fit in a double's mantissa exactly
+	static const int MAX_DIGITS = 15;
+
+	static inline bool is_blank (const char c) { return c == ' ' || c == '\t' || c == '\r'; }
+	static inline bool is_digit (const char c) { return c >= '0' && c <= '9'; }
+
+	/* Reads a number and moves p past it. Up to 15 significant digits the integer mantissa and the power of ten are both exact, so the one division gives the correctly rounded value - the same as strtod. Exponents and longer numbers are handed to strtod. */
+	static double parse_double (const char *& p, const char * end) {
+		while (p < end && is_blank(*p)) ++p;
+		const char * start = p;
+
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = (*p == '-');
+			++p;
+		}
+
+		unsigned long long mantissa = 0;
+		int digits = 0, decimals = 0;
+		while (p < end && is_digit(*p)) {
+			mantissa = mantissa * 10 + (*p++ - '0');
+			++digits;
+		}
+		if (p < end && *p == '.') {
+			++p;
+			while (p < end && is_digit(*p)) {
+				mantissa = mantissa * 10 + (*p++ - '0');
+				++digits;
+				++decimals;
+			}
+		}
+
+		if (digits && digits <= MAX_DIGITS && (p == end || !(*p == 'e' || *p == 'E' || *p == 'd' || *p == 'D'))) {
+			double value = (double)mantissa / POW10[decimals];
+			return negative ? -value : value;
+		}
+
+		// the token is copied out as the map isn't null-terminated
+		char token[64];
+		p = start;
+		int len = 0;
+		while (p < end && len < 63 && !is_blank(*p) && *p != '\n') {
+			token[len++] = (*p == 'd' || *p == 'D') ? 'e' : *p;		// fortran exponents
+			++p;
+		}
+		token[len] = '\0';
+		return strtod (token, (char **)NULL);
+	}
+
+	// moves p to the start of the next line
+	static inline void next_line (const char *& p, const char * end) {
+		const char * newline = (const char *)memchr (p, '\n', end - p);
+		p = (newline == (const char *)NULL) ? end : newline + 1;
+	}
+
+
+	XYZTextReader::XYZTextReader (const std::string& path) :
+		_path(path),
+		_map((const char *)NULL), _map_size(0),
+		_size(0),
+		_num_threads(1),
+		_chunk_first(-1), _chunk_frames(0) {
+
+			int fd = open (path.c_str(), O_RDONLY);
+			struct stat st;
+			if (fd < 0 || fstat (fd, &st) || st.st_size == 0) {
+				printf ("XYZTextReader c-tor - Couldn't open the xyz file %s\n", path.c_str());
+				exit(1);
+			}
+			void * map = mmap (NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			close (fd);
+			if (map == MAP_FAILED) {
+				printf ("XYZTextReader c-tor - Couldn't map the xyz file %s into memory\n", path.c_str());
+				exit(1);
+			}
+			_map = (const char *)map;
+			_map_size = (size_t)st.st_size;
+			madvise ((void *)_map, _map_size, MADV_SEQUENTIAL);
+
+			this->_IndexFrames();
+		}
+
+	XYZTextReader::~XYZTextReader () {
+		if (_map != (const char *)NULL)
+			munmap ((void *)_map, _map_size);
+	}
+
+	// moves p past a number (with an optional fortran or c exponent) that runs to the next blank or newline
+	static bool skip_number (const char *& p, const char * end) {
+		if (p < end && (*p == '-' || *p == '+')) ++p;
+		int digits = 0;
+		while (p < end && is_digit(*p)) { ++p; ++digits; }
+		if (p < end && *p == '.') {
+			++p;
+			while (p < end && is_digit(*p)) { ++p; ++digits; }
+		}
+		if (!digits) return false;
+		if (p < end && (*p == 'e' || *p == 'E' || *p == 'd' || *p == 'D')) {
+			++p;
+			if (p < end && (*p == '-' || *p == '+')) ++p;
+			if (p == end || !is_digit(*p)) return false;
+			while (p < end && is_digit(*p)) ++p;
+		}
+		return p < end && (is_blank(*p) || *p == '\n');
+	}
+
+	/* A binary xyz file starts with the atom count as a 4-byte int, then the length and null-terminated name of each atom (see XYZFile::_ReadHeader). A count of 2608-2617 reads as "26xx\n" in text, so the name records are checked for first - as many of them as were peeked at. */
+	static bool is_binary_xyz (const char * buffer, const size_t bytes) {
+		unsigned int count, len;
+		if (bytes < 2*sizeof(unsigned int)) return false;
+		memcpy (&count, buffer, sizeof(unsigned int));
+		if (!count) return false;
+
+		size_t p = sizeof(unsigned int);
+		unsigned int records = 0;
+		while (records < count && p + sizeof(unsigned int) <= bytes) {
+			memcpy (&len, buffer + p, sizeof(unsigned int));
+			p += sizeof(unsigned int);
+			if (len == 0 || len >= 16) return false;
+			if (p + len + 1 > bytes) break;
+			for (unsigned int i = 0; i < len; i++)
+				if (buffer[p+i] <= ' ' || buffer[p+i] > '~') return false;
+			if (buffer[p+len] != '\0') return false;
+			p += len + 1;
+			++records;
+		}
+		return records > 0;
+	}
+
+	// The file has to hold a whole text header: the count line, the comment line, and an atom line of a name and three coordinates
+	bool XYZTextReader::IsTextFile (const std::string& path) {
+		char buffer[4096];
+		const size_t bytes = GzipFile::Peek (path, buffer, sizeof(buffer));
+		if (is_binary_xyz (buffer, bytes)) return false;
+
+		const char * p = buffer;
+		const char * end = buffer + bytes;
+
+		// the count line
+		while (p < end && is_blank(*p)) ++p;
+		const char * digits = p;
+		while (p < end && is_digit(*p)) ++p;
+		if (p == digits) return false;
+		while (p < end && is_blank(*p)) ++p;
+		if (p == end || *p != '\n') return false;
+		++p;
+
+		// the comment line
+		const char * newline = (const char *)memchr (p, '\n', end - p);
+		if (newline == (const char *)NULL) return false;
+		p = newline + 1;
+
+		// the first atom
+		while (p < end && is_blank(*p)) ++p;
+		const char * name = p;
+		while (p < end && *p > ' ' && *p <= '~') ++p;
+		if (p == name || p == end || !is_blank(*p)) return false;
+		for (int i = 0; i < 3; i++) {
+			while (p < end && is_blank(*p)) ++p;
+			if (!skip_number (p, end)) return false;
+		}
+		return true;
+	}
+
+	/* Each frame is the atom count, a comment line, and then a line for each atom. Only the lines are counted here, so a frame costs a pass of memchr. A frame cut off at the end of the file is left out. */
+	void XYZTextReader::_IndexFrames () {
+		const char * p = _map;
+		const char * end = _map + _map_size;
+
+		while (p < end) {
+			while (p < end && (is_blank(*p) || *p == '\n')) ++p;
+			if (p == end) break;
+
+			const char * frame = p;
+			int num = 0;
+			while (p < end && is_digit(*p))
+				num = num * 10 + (*p++ - '0');
+
+			if (_frames.empty())
+				_size = num;
+			else if (num != _size) {
+				printf ("XYZTextReader - frame %d of %s has %d atoms instead of %d. Ignoring the rest of the file\n", (int)_frames.size(), _path.c_str(), num, _size);
+				break;
+			}
+
+			// the count line and the comment line, then the atoms
+			int lines = 0;
+			while (lines < _size + 2 && p < end) {
+				next_line (p, end);
+				++lines;
+			}
+			if (lines < _size + 2) break;
+			_frames.push_back (frame - _map);
+
+			// the atom names are taken from the first frame
+			if (_frames.size() == 1) {
+				const char * line = frame;
+				next_line (line, end);
+				next_line (line, end);
+				for (int i = 0; i < _size; i++) {
+					while (line < end && is_blank(*line)) ++line;
+					const char * name = line;
+					while (line < end && !is_blank(*line) && *line != '\n') ++line;
+					_names.push_back (std::string (name, line - name));
+					next_line (line, end);
+				}
+			}
+		}
+
+		if (_frames.empty()) {
+			printf ("XYZTextReader - Couldn't find any frames in %s\n", _path.c_str());
+			exit(1);
+		}
+		return;
+	}
+
+	void XYZTextReader::_ParseFrame (const int frame, double * coords) const {
+		const char * end = _map + _map_size;
+		const char * p = _map + _frames[frame];
+		next_line (p, end);
+		next_line (p, end);
+
+		for (int i = 0; i < _size; i++) {
+			// skip the name, then read the position. Anything after it on the line (e.g. the spread of a wannier center) is skipped
+			while (p < end && is_blank(*p)) ++p;
+			while (p < end && !is_blank(*p) && *p != '\n') ++p;
+			coords[3*i] = parse_double (p, end);
+			coords[3*i+1] = parse_double (p, end);
+			coords[3*i+2] = parse_double (p, end);
+			next_line (p, end);
+		}
+		return;
+	}
+
+	std::string XYZTextReader::Header (const int frame) const {
+		const char * end = _map + _map_size;
+		const char * p = _map + _frames[frame];
+		next_line (p, end);
+		const char * header = p;
+		next_line (p, end);
+		return std::string (header, p - header);
+	}
+
+	// pthread-compatible function for parsing one thread's frames of a chunk
+	void * parse_text_block (void * thread_data) {
+		XYZTextReader::ParseThread * thread = (XYZTextReader::ParseThread *)thread_data;
+		thread->reader->_ParseBlock (*thread);
+		pthread_exit(NULL);
+		return NULL;
+	}
+
+	void XYZTextReader::_ParseBlock (const ParseThread& thread) {
+		int low = threads::block_low (thread.id, _num_threads, _chunk_frames);
+		int high = threads::block_high (thread.id, _num_threads, _chunk_frames);
+		for (int f = low; f <= high; f++)
+			this->_ParseFrame (_chunk_first + f, &_chunk[(size_t)f * 3 * _size]);
+		return;
+	}
+
+	// parses the frames from first on - as many as there are threads
+	void XYZTextReader::_ParseChunk (const int first) {
+		_chunk_first = first;
+		_chunk_frames = std::min(_num_threads, (int)_frames.size() - first);
+		_chunk.resize ((size_t)_chunk_frames * 3 * _size);
+
+		if (_chunk_frames == 1) {
+			this->_ParseFrame (first, &_chunk[0]);
+			return;
+		}
+
+		if ((int)_threads.size() != _num_threads)
+			_threads.resize(_num_threads);
+
+		std::vector<pthread_t> thread_ids (_num_threads);
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+		for (int t = 0; t < _num_threads; t++) {
+			_threads[t].reader = this;
+			_threads[t].id = t;
+			int rc = pthread_create(&thread_ids[t], &attr, parse_text_block, (void *)&_threads[t]);
+			if (rc) {
+				printf ("XYZTextReader::_ParseChunk() - couldn't create parsing thread %d (error code %d)\n", t, rc);
+				exit(1);
+			}
+		}
+
+		for (int t = 0; t < _num_threads; t++) {
+			pthread_join(thread_ids[t], NULL);
+		}
+		pthread_attr_destroy(&attr);
+		return;
+	}
+
+	void XYZTextReader::LoadFrame (const int frame, double * coords) {
+		if (frame < 0 || frame >= (int)_frames.size()) {
+			printf ("XYZTextReader::LoadFrame() - frame %d is out of range. The file %s has %d frames\n", frame, _path.c_str(), (int)_frames.size());
+			exit(1);
+		}
+
+		if (_chunk_first < 0 || frame < _chunk_first || frame >= _chunk_first + _chunk_frames)
+			this->_ParseChunk (frame);
+
+		memcpy (coords, &_chunk[(size_t)(frame - _chunk_first) * 3 * _size], 3 * _size * sizeof(double));
+		return;
+	}
+
+}	// namespace md_files
@@ -0,0 +1,72 @@
+#ifndef XYZTEXT_H_
+#define XYZTEXT_H_
+
+#include "threading.h"
+#include "gzipfile.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Reads text xyz files (e.g. the CP2K position and wannier center output) without converting them to binary first
+
+namespace md_files {
+
+	/* The file is memory-mapped and the start of every frame is found up front by counting lines, so frames can be loaded in any order. Frames are parsed a chunk at a time - one frame to each thread - and handed out of the chunk until the next one is needed. The numbers are read with a parser that's exact for the fixed-point values these files hold, and falls back to strtod for anything else. */
+	class XYZTextReader {
+
+		public:
+			XYZTextReader (const std::string& path);
+			~XYZTextReader ();
+
+			// checks that the file starts with a text xyz header - the atom count line, a comment line, and a "name x y z" line - and not the atom name records of a binary xyz file. Compressed files are checked on their uncompressed data
+			static bool IsTextFile (const std::string& path);
+
+			int NumFrames () const { return (int)_frames.size(); }
+			int size () const { return _size; }
+			const std::vector<std::string>& AtomNames () const { return _names; }
+
+			// copies the positions of the given frame into coords
+			void LoadFrame (const int frame, double * coords);
+			// the comment line of a frame (CP2K writes the step, time and energy there)
+			std::string Header (const int frame) const;
+
+			// the number of threads (and so of frames in a chunk) used to parse the frames
+			void Threads (const int num) { _num_threads = (num > 1) ? num : 1; }
+
+			// one thread's share of a chunk
+			struct ParseThread {
+				XYZTextReader *	reader;
+				int							id;
+			};
+
+		protected:
+			std::string		_path;
+			const char *	_map;
+			size_t				_map_size;
+
+			int						_size;				// number of positions in each frame
+			std::vector<std::string>	_names;
+			std::vector<size_t>				_frames;			// where each frame starts in the file
+
+			int						_num_threads;
+			int						_chunk_first;		// the first frame of the parsed chunk
+			int						_chunk_frames;
+			std::vector<double>				_chunk;
+			std::vector<ParseThread>	_threads;
+
+			void _IndexFrames ();
+			void _ParseChunk (const int first);
+			void _ParseFrame (const int frame, double * coords) const;
+			void _ParseBlock (const ParseThread& thread);
+			friend void * parse_text_block (void * thread_data);
+	};
+
+}	// namespace md_files
+#endif